@@ -114,6 +114,7 @@ void loop( void ) ;
 
 #ifdef __cplusplus
 #include "Uart.h"
+#include "SoftUart.h"
 #endif // __cplusplus
 
 #endif // Arduino_h
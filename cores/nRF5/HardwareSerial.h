@@ -64,6 +64,20 @@
 #define SERIAL_7O2	(HARDSER_STOP_BIT_2 | HARDSER_PARITY_ODD  | HARDSER_DATA_7)
 #define SERIAL_8O2	(HARDSER_STOP_BIT_2 | HARDSER_PARITY_ODD  | HARDSER_DATA_8)
 
+// Link statistics, see Uart::stats(). Counted since begin() or resetStats().
+struct SerialStats
+{
+  uint32_t rxBytes;        // bytes received
+  uint32_t txBytes;        // bytes sent
+  uint32_t rxDropped;      // received bytes lost because the RX buffer was full
+  uint32_t overrunErrors;  // bytes lost in the peripheral before they were read
+  uint32_t framingErrors;  // bytes without a valid stop bit
+  uint32_t parityErrors;
+  uint32_t breaks;         // break conditions on the RX line
+  uint32_t rxPeak;         // highest RX buffer occupancy, in bytes
+  uint32_t maxIrqLatency;  // longest RX interrupt delay, in microseconds
+};
+
 class HardwareSerial : public Stream
 {
   public:
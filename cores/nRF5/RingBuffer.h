@@ -20,31 +20,232 @@
 #define _RING_BUFFER_
 
 #include <stdint.h>
+#include <stddef.h>
+#include <string.h>
 
 // Define constants and variables for buffering incoming serial data.  We're
-// using a ring buffer (I think), in which head is the index of the location
-// to which to write the next incoming character and tail is the index of the
-// location from which to read.
+// using a ring buffer, in which head is the count of characters ever written
+// and tail the count of characters ever read. Both run freely and are masked
+// into the buffer, so N must be a power of two and all N bytes are usable.
+//
+// The buffer is a lock-free single-producer/single-consumer queue: one side
+// (typically an ISR) may store while the other reads, without disabling
+// interrupts. Only the producer moves the head and only the consumer moves
+// the tail; each publishes its index with release semantics and reads the
+// other's with acquire semantics, so the data is visible before the index
+// and polling loops always see fresh values. clear() must only be called
+// while neither side is active.
 #define SERIAL_BUFFER_SIZE 64
 
-class RingBuffer
+template <int N>
+class RingBufferN
 {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "RingBufferN size must be a power of two");
+
   public:
-    uint8_t _aucBuffer[SERIAL_BUFFER_SIZE] ;
-    int _iHead ;
-    int _iTail ;
+    uint8_t _aucBuffer[N] ;
 
   public:
-    RingBuffer( void ) ;
+    RingBufferN( void ) ;
     void store_char( uint8_t c ) ;
-	void clear();
-	int read_char();
-	int available();
-	int peek();
-	bool isFull();
+    void clear();
+    int read_char();
+    int available();
+    int availableForStore();
+    int peek();
+    bool isFull();
+
+    // Bulk copies, each done with at most two memcpy calls. They return the
+    // number of bytes actually stored or read.
+    size_t write(const uint8_t *data, size_t n);
+    size_t read(uint8_t *data, size_t n);
+
+    // Bytes readable from tailPtr() without wrapping, e.g. for EasyDMA.
+    size_t contiguousAvailable();
+    uint8_t *tailPtr();
+    void advanceTail(size_t n);
+
+    // Space writable at headPtr() without wrapping, e.g. for EasyDMA;
+    // advanceHead() then makes the bytes written there readable.
+    size_t contiguousForStore();
+    uint8_t *headPtr();
+    void advanceHead(size_t n);
 
   private:
-	int nextIndex(int index);
+    uint32_t _iHead ;
+    uint32_t _iTail ;
+
+    uint32_t loadHead() { return __atomic_load_n(&_iHead, __ATOMIC_ACQUIRE); }
+    uint32_t loadTail() { return __atomic_load_n(&_iTail, __ATOMIC_ACQUIRE); }
+    void storeHead(uint32_t head) { __atomic_store_n(&_iHead, head, __ATOMIC_RELEASE); }
+    void storeTail(uint32_t tail) { __atomic_store_n(&_iTail, tail, __ATOMIC_RELEASE); }
+
+    static const uint32_t mask = N - 1;
 } ;
 
+typedef RingBufferN<SERIAL_BUFFER_SIZE> RingBuffer;
+
+
+template <int N>
+RingBufferN<N>::RingBufferN( void )
+{
+    memset( _aucBuffer, 0, N ) ;
+    clear();
+}
+
+template <int N>
+void RingBufferN<N>::store_char( uint8_t c )
+{
+  uint32_t head = _iHead;
+
+  // if the buffer is full we don't write the character or advance the head
+  if ( (head - loadTail()) != N )
+  {
+    _aucBuffer[head & mask] = c ;
+    storeHead(head + 1) ;
+  }
+}
+
+template <int N>
+void RingBufferN<N>::clear()
+{
+	storeHead(0);
+	storeTail(0);
+}
+
+template <int N>
+int RingBufferN<N>::read_char()
+{
+	uint32_t tail = _iTail;
+
+	if(tail == loadHead())
+		return -1;
+
+	uint8_t value = _aucBuffer[tail & mask];
+	storeTail(tail + 1);
+
+	return value;
+}
+
+template <int N>
+int RingBufferN<N>::available()
+{
+	uint32_t tail = loadTail();
+
+	return loadHead() - tail;
+}
+
+template <int N>
+int RingBufferN<N>::availableForStore()
+{
+	return N - available();
+}
+
+template <int N>
+int RingBufferN<N>::peek()
+{
+	uint32_t tail = _iTail;
+
+	if(tail == loadHead())
+		return -1;
+
+	return _aucBuffer[tail & mask];
+}
+
+template <int N>
+bool RingBufferN<N>::isFull()
+{
+	return (uint32_t)available() == N;
+}
+
+template <int N>
+size_t RingBufferN<N>::write(const uint8_t *data, size_t n)
+{
+	uint32_t head = _iHead;
+	size_t space = N - (head - loadTail());
+
+	if (n > space)
+		n = space;
+
+	size_t index = head & mask;
+	size_t first = N - index;
+
+	if (first > n)
+		first = n;
+
+	memcpy(&_aucBuffer[index], data, first);
+	memcpy(_aucBuffer, data + first, n - first);
+
+	storeHead(head + n);
+
+	return n;
+}
+
+template <int N>
+size_t RingBufferN<N>::read(uint8_t *data, size_t n)
+{
+	uint32_t tail = _iTail;
+	size_t count = loadHead() - tail;
+
+	if (n > count)
+		n = count;
+
+	size_t index = tail & mask;
+	size_t first = N - index;
+
+	if (first > n)
+		first = n;
+
+	memcpy(data, &_aucBuffer[index], first);
+	memcpy(data + first, _aucBuffer, n - first);
+
+	storeTail(tail + n);
+
+	return n;
+}
+
+template <int N>
+size_t RingBufferN<N>::contiguousAvailable()
+{
+	uint32_t tail = _iTail;
+	size_t count = loadHead() - tail;
+	size_t first = N - (tail & mask);
+
+	return (count < first) ? count : first;
+}
+
+template <int N>
+uint8_t *RingBufferN<N>::tailPtr()
+{
+	return &_aucBuffer[_iTail & mask];
+}
+
+template <int N>
+void RingBufferN<N>::advanceTail(size_t n)
+{
+	storeTail(_iTail + n);
+}
+
+template <int N>
+size_t RingBufferN<N>::contiguousForStore()
+{
+	uint32_t head = _iHead;
+	size_t space = N - (head - loadTail());
+	size_t first = N - (head & mask);
+
+	return (space < first) ? space : first;
+}
+
+template <int N>
+uint8_t *RingBufferN<N>::headPtr()
+{
+	return &_aucBuffer[_iHead & mask];
+}
+
+template <int N>
+void RingBufferN<N>::advanceHead(size_t n)
+{
+	storeHead(_iHead + n);
+}
+
 #endif /* _RING_BUFFER_ */
@@ -0,0 +1,704 @@
+/*
+  Copyright (c) 2015 Arduino LLC.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifdef NRF52
+
+#include "SoftUart.h"
+#include "Arduino.h"
+#include "wiring_private.h"
+
+// The edge interrupts of all ports come in through one EGU
+#define SOFTUART_EGU       NRF_EGU3
+#define SOFTUART_EGU_IRQn  SWI3_EGU3_IRQn
+
+// Above Serial, so edges are handled within a bit time
+#ifndef SOFTUART_IRQ_PRIORITY
+#define SOFTUART_IRQ_PRIORITY 2
+#endif
+
+// Compare registers: CC0 captures RX edges, CC1 marks the end of an RX
+// frame, CC2 is used to read the time and CC3-5 hold the queued TX edges.
+#define CC_RX_EDGE  0
+#define CC_RX_END   1
+#define CC_NOW      2
+#define CC_TX       3
+
+#define TX_EDGE     1
+#define TX_END      2
+
+static SoftUart *softUarts[2];
+
+SoftUart::SoftUart(NRF_TIMER_Type *_timer, uint8_t _pinRX, uint8_t _pinTX)
+{
+  timer = _timer;
+  uc_pinRX = g_ADigitalPinMap[_pinRX];
+  uc_pinTX = g_ADigitalPinMap[_pinTX];
+  gpioteRX = -1;
+  gpioteTX = -1;
+
+  if (timer == NRF_TIMER3) {
+    index = 0;
+    timerIRQn = TIMER3_IRQn;
+  } else if (timer == NRF_TIMER4) {
+    index = 1;
+    timerIRQn = TIMER4_IRQn;
+  } else {
+    // unusable, begin() refuses it and write() discards
+    index = -1;
+  }
+
+  ppiCh = 0;
+}
+
+void SoftUart::begin(unsigned long baudrate)
+{
+  begin(baudrate, (uint8_t)SERIAL_8N1);
+}
+
+void SoftUart::begin(unsigned long baudrate, uint16_t /*config*/)
+{
+  if (index < 0 || softUarts[index]) {
+    return;
+  }
+
+  // the timer comes with its PPI channels, unless a stream has them
+  int ch = timerReserve(timer);
+
+  if (ch < 0) {
+    return;
+  }
+
+  gpioteRX = gpioteReserve();
+  gpioteTX = gpioteReserve();
+
+  if (gpioteRX < 0 || gpioteTX < 0) {
+    gpioteRelease(gpioteRX);
+    gpioteRelease(gpioteTX);
+    timerRelease(timer);
+    return;
+  }
+
+  ppiCh = ch;
+
+  for (int k = 0; k <= 10; k++) {
+    bitTicks[k] = (k * 16000000UL + baudrate / 2) / baudrate;
+  }
+  halfBitTicks = (8000000UL + baudrate / 2) / baudrate;
+
+  rxBuffer.clear();
+  txBuffer.clear();
+  resetStats();
+
+  softUarts[index] = this;
+
+  // RX pin with pull-up, edges in both directions are captured
+  NRF_GPIO->PIN_CNF[uc_pinRX] = ((uint32_t)GPIO_PIN_CNF_DIR_Input        << GPIO_PIN_CNF_DIR_Pos)
+                              | ((uint32_t)GPIO_PIN_CNF_INPUT_Connect    << GPIO_PIN_CNF_INPUT_Pos)
+                              | ((uint32_t)GPIO_PIN_CNF_PULL_Pullup      << GPIO_PIN_CNF_PULL_Pos)
+                              | ((uint32_t)GPIO_PIN_CNF_DRIVE_S0S1       << GPIO_PIN_CNF_DRIVE_Pos)
+                              | ((uint32_t)GPIO_PIN_CNF_SENSE_Disabled   << GPIO_PIN_CNF_SENSE_Pos);
+
+  NRF_GPIOTE->CONFIG[gpioteRX] = (GPIOTE_CONFIG_MODE_Event << GPIOTE_CONFIG_MODE_Pos)
+                               | (uc_pinRX << GPIOTE_CONFIG_PSEL_Pos)
+                               | (GPIOTE_CONFIG_POLARITY_Toggle << GPIOTE_CONFIG_POLARITY_Pos);
+  NRF_GPIOTE->EVENTS_IN[gpioteRX] = 0x0UL;
+
+  // TX pin idles high; GPIOTE drives it while the port is open
+  NRF_GPIO->OUTSET = (1UL << uc_pinTX);
+  NRF_GPIO->PIN_CNF[uc_pinTX] = ((uint32_t)GPIO_PIN_CNF_DIR_Output       << GPIO_PIN_CNF_DIR_Pos)
+                              | ((uint32_t)GPIO_PIN_CNF_INPUT_Disconnect << GPIO_PIN_CNF_INPUT_Pos)
+                              | ((uint32_t)GPIO_PIN_CNF_PULL_Disabled    << GPIO_PIN_CNF_PULL_Pos)
+                              | ((uint32_t)GPIO_PIN_CNF_DRIVE_S0S1       << GPIO_PIN_CNF_DRIVE_Pos)
+                              | ((uint32_t)GPIO_PIN_CNF_SENSE_Disabled   << GPIO_PIN_CNF_SENSE_Pos);
+
+  NRF_GPIOTE->CONFIG[gpioteTX] = (GPIOTE_CONFIG_MODE_Task << GPIOTE_CONFIG_MODE_Pos)
+                               | (uc_pinTX << GPIOTE_CONFIG_PSEL_Pos)
+                               | (GPIOTE_CONFIG_POLARITY_Toggle << GPIOTE_CONFIG_POLARITY_Pos)
+                               | (GPIOTE_CONFIG_OUTINIT_High << GPIOTE_CONFIG_OUTINIT_Pos);
+
+  // free running 16 MHz time base
+  timer->TASKS_STOP = 0x1UL;
+  timer->INTENCLR = 0xFFFFFFFF;
+  timer->SHORTS = 0;
+  timer->MODE = TIMER_MODE_MODE_Timer;
+  timer->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  timer->PRESCALER = 0;
+  timer->TASKS_CLEAR = 0x1UL;
+  timer->TASKS_START = 0x1UL;
+
+  for (int i = 0; i < 6; i++) {
+    timer->EVENTS_COMPARE[i] = 0x0UL;
+  }
+
+  rxLevel = (NRF_GPIO->IN >> uc_pinRX) & 1;
+  rxActive = false;
+  rxHunting = false;
+  rxLastEdge = now();
+
+  txActive = false;
+  txEnding = false;
+  txLevel = 1;
+  txBit = 10;
+  txOldest = 0;
+  txCount = 0;
+
+  // each RX edge is timestamped, and raises the edge interrupt via the EGU
+  NRF_PPI->CH[ppiCh].EEP = (uint32_t)&NRF_GPIOTE->EVENTS_IN[gpioteRX];
+  NRF_PPI->CH[ppiCh].TEP = (uint32_t)&timer->TASKS_CAPTURE[CC_RX_EDGE];
+  NRF_PPI->FORK[ppiCh].TEP = (uint32_t)&SOFTUART_EGU->TASKS_TRIGGER[index];
+
+  // each TX slot's compare event drives the pin; SET or CLR is chosen as
+  // the slot is armed
+  for (int slot = 0; slot < SOFTUART_TX_SLOTS; slot++) {
+    NRF_PPI->CH[ppiCh + 1 + slot].EEP = (uint32_t)&timer->EVENTS_COMPARE[CC_TX + slot];
+  }
+
+  SOFTUART_EGU->EVENTS_TRIGGERED[index] = 0x0UL;
+  SOFTUART_EGU->INTENSET = (1UL << index);
+
+  NRF_PPI->CHENSET = (1UL << ppiCh);
+
+  NVIC_ClearPendingIRQ(SOFTUART_EGU_IRQn);
+  NVIC_SetPriority(SOFTUART_EGU_IRQn, SOFTUART_IRQ_PRIORITY);
+  NVIC_EnableIRQ(SOFTUART_EGU_IRQn);
+
+  NVIC_ClearPendingIRQ(timerIRQn);
+  NVIC_SetPriority(timerIRQn, SOFTUART_IRQ_PRIORITY);
+  NVIC_EnableIRQ(timerIRQn);
+}
+
+void SoftUart::end()
+{
+  if (index < 0 || softUarts[index] != this) {
+    return;
+  }
+
+  flush();
+
+  NVIC_DisableIRQ(timerIRQn);
+
+  SOFTUART_EGU->INTENCLR = (1UL << index);
+  NRF_PPI->CHENCLR = (0xFUL << ppiCh);
+  NRF_PPI->FORK[ppiCh].TEP = 0;
+
+  timer->INTENCLR = 0xFFFFFFFF;
+  timer->TASKS_STOP = 0x1UL;
+
+  // hands the TX pin back to the GPIO, which holds it high
+  gpioteRelease(gpioteRX);
+  gpioteRelease(gpioteTX);
+  gpioteRX = -1;
+  gpioteTX = -1;
+
+  timerRelease(timer);
+  softUarts[index] = NULL;
+
+  rxBuffer.clear();
+  txBuffer.clear();
+}
+
+// Reads the time base
+uint32_t SoftUart::now()
+{
+  timer->TASKS_CAPTURE[CC_NOW] = 0x1UL;
+
+  return timer->CC[CC_NOW];
+}
+
+// True when the port's interrupts cannot preempt the caller, e.g. when
+// writing with interrupts disabled or from an ISR of equal or higher
+// priority.
+bool SoftUart::irqBlocked()
+{
+  if (__get_PRIMASK()) {
+    return true;
+  }
+
+  uint32_t ipsr = __get_IPSR();
+
+  if (ipsr == 0) {
+    return false;
+  } else if (ipsr < 16) {
+    return true;
+  }
+
+  return NVIC_GetPriority((IRQn_Type)(ipsr - 16)) <= NVIC_GetPriority(timerIRQn);
+}
+
+void SoftUart::flush()
+{
+  // wait for the ring buffer to drain and the last stop bit to end
+  while (txBuffer.available() || txActive) {
+    if (irqBlocked()) {
+      txService();
+    }
+  }
+}
+
+// Gets an idle transmitter going. The transmitter is normally only touched
+// at interrupt priority, so this just pends the timer interrupt.
+void SoftUart::txKick()
+{
+  // the data is stored before this looks at txActive, so a transmitter
+  // stopping in between still picks it up
+  if (txActive || index < 0 || softUarts[index] != this) {
+    return;
+  }
+
+  if (irqBlocked()) {
+    txService();
+  } else {
+    NVIC_SetPendingIRQ(timerIRQn);
+  }
+}
+
+// Starts sending what is in the buffer, one bit time from now.
+void SoftUart::txRestart()
+{
+  txFrameStart = now() + bitTicks[1] - bitTicks[10];
+  txBit = 10;
+  txLevel = 1;
+  txEnding = false;
+  txActive = true;
+
+  txFill();
+
+  if (!txCount) {
+    txActive = false;
+  }
+}
+
+// Produces the next transition of the TX line. Returns TX_EDGE with the
+// time of the edge, TX_END with the time the last stop bit ends, or 0 once
+// the end has been handed out.
+int SoftUart::txNextEdge(uint32_t &when)
+{
+  for (;;) {
+    while (txBit < 10) {
+      uint8_t bit = txBit++;
+      uint8_t level = (txFrame >> bit) & 1;
+
+      if (level != txLevel) {
+        txLevel = level;
+        when = txFrameStart + bitTicks[bit];
+
+        return TX_EDGE;
+      }
+    }
+
+    if (txEnding) {
+      return 0;
+    }
+
+    int c = txBuffer.read_char();
+
+    if (c < 0) {
+      txEnding = true;
+      when = txFrameStart + bitTicks[10];
+
+      return TX_END;
+    }
+
+    counters.txBytes++;
+
+    // frames follow each other back to back
+    txFrameStart += bitTicks[10];
+    txFrame = ((uint16_t)c << 1) | (1 << 9);
+    txBit = 0;
+  }
+}
+
+// Queues the next transition in the given slot.
+bool SoftUart::txArm(uint8_t slot)
+{
+  uint32_t when;
+  int edge = txNextEdge(when);
+
+  if (!edge) {
+    return false;
+  }
+
+  uint8_t cc = CC_TX + slot;
+  uint8_t ch = ppiCh + 1 + slot;
+
+  timer->CC[cc] = when;
+  timer->EVENTS_COMPARE[cc] = 0x0UL;
+
+  if (edge == TX_EDGE) {
+    txSlotLevel[slot] = txLevel;
+
+    NRF_PPI->CH[ch].TEP = txLevel ? (uint32_t)&NRF_GPIOTE->TASKS_SET[gpioteTX]
+                                  : (uint32_t)&NRF_GPIOTE->TASKS_CLR[gpioteTX];
+    NRF_PPI->CHENSET = (1UL << ch);
+  } else {
+    txSlotLevel[slot] = TX_END;
+
+    NRF_PPI->CHENCLR = (1UL << ch);
+  }
+
+  timer->INTENSET = (TIMER_INTENSET_COMPARE0_Msk << cc);
+
+  return true;
+}
+
+// Fills the free slots, in time order after the ones already queued.
+void SoftUart::txFill()
+{
+  while (txCount < SOFTUART_TX_SLOTS) {
+    if (!txArm((txOldest + txCount) % SOFTUART_TX_SLOTS)) {
+      break;
+    }
+
+    txCount++;
+  }
+}
+
+void SoftUart::TimerIrqHandler()
+{
+  timer->EVENTS_COMPARE[CC_RX_END] = 0x0UL;
+
+  // go by the time rather than the event: the edge interrupt may already
+  // have finished this frame and started the next one
+  if (rxActive && (int32_t)(now() - timer->CC[CC_RX_END]) >= 0) {
+    rxFinish();
+
+    // resync the level in case an edge was lost, unless one is pending
+    uint8_t level = (NRF_GPIO->IN >> uc_pinRX) & 1;
+
+    if (!SOFTUART_EGU->EVENTS_TRIGGERED[index]) {
+      rxLevel = level;
+    }
+  }
+
+  txService();
+
+#if __CORTEX_M == 0x04
+  volatile uint32_t dummy = timer->EVENTS_COMPARE[CC_RX_END];
+  (void)dummy;
+#endif
+}
+
+// Retires the TX slots that have gone out and queues the next edges. A
+// writer in a higher priority ISR may run this too, so it runs with
+// interrupts off.
+void SoftUart::txService()
+{
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+
+  // retire the slots whose edges have gone out, oldest first
+  while (txCount) {
+    uint8_t slot = txOldest;
+    uint8_t cc = CC_TX + slot;
+
+    if (!timer->EVENTS_COMPARE[cc]) {
+      if ((int32_t)(now() - timer->CC[cc]) < 0) {
+        break;
+      }
+
+      // due, and still no compare event after reading the time: the slot
+      // was armed too late for the compare to match, so drive the edge by
+      // hand (SET and CLR do no harm if it did go out)
+      if (!timer->EVENTS_COMPARE[cc]) {
+        if (txSlotLevel[slot] == 1) {
+          NRF_GPIOTE->TASKS_SET[gpioteTX] = 0x1UL;
+        } else if (txSlotLevel[slot] == 0) {
+          NRF_GPIOTE->TASKS_CLR[gpioteTX] = 0x1UL;
+        }
+      }
+    }
+
+    timer->EVENTS_COMPARE[cc] = 0x0UL;
+    timer->INTENCLR = (TIMER_INTENCLR_COMPARE0_Msk << cc);
+    NRF_PPI->CHENCLR = (1UL << (ppiCh + 1 + slot));
+
+    txOldest = (slot + 1) % SOFTUART_TX_SLOTS;
+    txCount--;
+
+    if (txSlotLevel[slot] == TX_END) {
+      txActive = false;
+    } else {
+      txFill();
+    }
+  }
+
+  if (!txActive && txBuffer.available()) {
+    txRestart();
+  }
+
+  __set_PRIMASK(primask);
+}
+
+void SoftUart::EdgeIrqHandler()
+{
+  if (SOFTUART_EGU->EVENTS_TRIGGERED[index])
+  {
+    SOFTUART_EGU->EVENTS_TRIGGERED[index] = 0x0UL;
+
+#if __CORTEX_M == 0x04
+    volatile uint32_t dummy = SOFTUART_EGU->EVENTS_TRIGGERED[index];
+    (void)dummy;
+#endif
+
+    // an edge arriving after the event was cleared triggers again, but
+    // its capture may already be read here
+    uint32_t when = timer->CC[CC_RX_EDGE];
+
+    if (when != rxLastEdge) {
+      uint32_t lag = now() - when;
+
+      if (lag > rxLagMax) {
+        rxLagMax = lag;
+      }
+
+      uint32_t gap = when - rxLastEdge;
+
+      rxLastEdge = when;
+      rxEdge(when, gap);
+    }
+
+    // the line must be at the level the handled edges lead to, unless
+    // another edge is pending; if not, edges were lost while this interrupt
+    // was held off and the frame would come out wrong
+    uint8_t level = (NRF_GPIO->IN >> uc_pinRX) & 1;
+
+    if (level != rxLevel && !SOFTUART_EGU->EVENTS_TRIGGERED[index]) {
+      rxLost(level);
+    }
+  }
+}
+
+// Drops the frame an edge went missing from, and ignores start bits until
+// the line has been idle for a whole frame, so that a data bit isn't taken
+// for one.
+void SoftUart::rxLost(uint8_t level)
+{
+  if (rxActive) {
+    counters.overrunErrors++;
+    rxActive = false;
+
+    timer->INTENCLR = TIMER_INTENCLR_COMPARE1_Msk;
+  }
+
+  rxLevel = level;
+  rxHunting = true;
+}
+
+// Sets the bits of the current frame up to the given one to the line level.
+void SoftUart::rxFill(uint8_t bit)
+{
+  if (rxLevel) {
+    rxFrame |= ((1U << bit) - 1) & ~((1U << rxBit) - 1);
+  }
+
+  rxBit = bit;
+}
+
+void SoftUart::rxEdge(uint32_t when, uint32_t gap)
+{
+  if (rxActive) {
+    uint32_t elapsed = when - rxStart;
+
+    if (elapsed >= bitTicks[9] + halfBitTicks) {
+      // the frame ended before this edge; its end interrupt is still due
+      rxFinish();
+    } else {
+      // the level before the edge holds up to the nearest bit boundary
+      uint8_t bit = rxBit;
+
+      while (bit < 10 && bitTicks[bit + 1] <= elapsed + halfBitTicks) {
+        bit++;
+      }
+
+      rxFill(bit);
+    }
+  }
+
+  rxLevel ^= 1;
+
+  // after a lost edge, the gap before a start bit is idle line
+  if (rxHunting && rxLevel == 0 && gap >= bitTicks[9] + halfBitTicks) {
+    rxHunting = false;
+  }
+
+  if (!rxActive && !rxHunting && rxLevel == 0) {
+    // start bit
+    rxActive = true;
+    rxStart = when;
+    rxFrame = 0;
+    rxBit = 0;
+
+    // the frame is complete in the middle of the stop bit
+    timer->CC[CC_RX_END] = when + bitTicks[9] + halfBitTicks;
+    timer->EVENTS_COMPARE[CC_RX_END] = 0x0UL;
+    timer->INTENSET = TIMER_INTENSET_COMPARE1_Msk;
+
+    // already past when the edge was handled late
+    if ((int32_t)(now() - timer->CC[CC_RX_END]) >= 0) {
+      NVIC_SetPendingIRQ(timerIRQn);
+    }
+  }
+}
+
+void SoftUart::rxFinish()
+{
+  rxFill(10);
+
+  // start bit low and stop bit high, otherwise it is a framing error
+  if (!(rxFrame & 0x001) && (rxFrame & 0x200)) {
+    counters.rxBytes++;
+
+    if (rxBuffer.isFull()) {
+      counters.rxDropped++;
+    } else {
+      rxBuffer.store_char((rxFrame >> 1) & 0xFF);
+
+      uint32_t used = rxBuffer.available();
+
+      if (used > counters.rxPeak) {
+        counters.rxPeak = used;
+      }
+    }
+  } else {
+    counters.framingErrors++;
+  }
+
+  rxActive = false;
+
+  timer->INTENCLR = TIMER_INTENCLR_COMPARE1_Msk;
+}
+
+// The counters are updated from the ISRs without locking; a copy may be a
+// count or two apart between fields, which is fine for statistics.
+SerialStats SoftUart::stats()
+{
+  SerialStats s = counters;
+
+  s.maxIrqLatency = rxLagMax / 16;
+
+  return s;
+}
+
+void SoftUart::resetStats()
+{
+  memset(&counters, 0, sizeof(counters));
+  rxLagMax = 0;
+}
+
+int SoftUart::available()
+{
+  return rxBuffer.available();
+}
+
+int SoftUart::peek()
+{
+  return rxBuffer.peek();
+}
+
+int SoftUart::read()
+{
+  return rxBuffer.read_char();
+}
+
+int SoftUart::availableForWrite()
+{
+  return txBuffer.availableForStore();
+}
+
+size_t SoftUart::write(const uint8_t data)
+{
+  // nothing would ever drain the buffer
+  if (index < 0 || softUarts[index] != this) {
+    return 0;
+  }
+
+  // only wait when the buffer is full; if the interrupt cannot run from
+  // here, service the transmitter directly
+  while (txBuffer.isFull()) {
+    if (irqBlocked()) {
+      txService();
+    }
+  }
+
+  // writers in different interrupts must not store at the same time
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  txBuffer.store_char(data);
+  __set_PRIMASK(primask);
+
+  txKick();
+
+  return 1;
+}
+
+size_t SoftUart::write(const uint8_t *buffer, size_t size)
+{
+  size_t count = 0;
+
+  if (index < 0 || softUarts[index] != this) {
+    return 0;
+  }
+
+  while (count < size) {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    size_t n = txBuffer.write(buffer + count, size - count);
+    __set_PRIMASK(primask);
+
+    count += n;
+
+    txKick();
+
+    if (!n && irqBlocked()) {
+      txService();
+    }
+  }
+
+  return size;
+}
+
+extern "C"
+{
+  void TIMER3_IRQHandler()
+  {
+    if (softUarts[0]) {
+      softUarts[0]->TimerIrqHandler();
+    }
+  }
+
+  void TIMER4_IRQHandler()
+  {
+    if (softUarts[1]) {
+      softUarts[1]->TimerIrqHandler();
+    }
+  }
+
+  void SWI3_EGU3_IRQHandler()
+  {
+    for (int i = 0; i < 2; i++) {
+      if (softUarts[i]) {
+        softUarts[i]->EdgeIrqHandler();
+      }
+    }
+  }
+}
+
+#endif // NRF52
@@ -0,0 +1,144 @@
+/*
+  Copyright (c) 2015 Arduino LLC.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#ifdef NRF52
+
+#include <nrf.h>
+
+#include "HardwareSerial.h"
+#include "RingBuffer.h"
+#include "variant.h"
+
+#include <cstddef>
+
+// Ring buffer sizes, may be overridden by the variant or build flags.
+// Both must be powers of two.
+#ifndef SOFTUART_RX_BUFFER_SIZE
+#define SOFTUART_RX_BUFFER_SIZE SERIAL_BUFFER_SIZE
+#endif
+#ifndef SOFTUART_TX_BUFFER_SIZE
+#define SOFTUART_TX_BUFFER_SIZE SERIAL_BUFFER_SIZE
+#endif
+
+// Number of TX edges scheduled ahead in the timer's compare registers
+#define SOFTUART_TX_SLOTS 3
+
+// 8N1 serial port on any two pins, for use next to the single UARTE.
+//
+// All bit timing is done by a 16 MHz TIMER. GPIOTE and PPI capture the time
+// of every RX edge, and transmit edges are driven by GPIOTE tasks on timer
+// compare events, so interrupt latency does not move any edge. The CPU still
+// takes an interrupt for every line transition, up to ten per byte in each
+// direction, plus one per received byte. TX has three edges queued ahead.
+//
+// RX is the weak side: the edge interrupt must be serviced before the next
+// edge (one bit time, 104 us at 9600 and 8.7 us at 115200 baud), as only the
+// latest edge time is captured. While the radio is active the SoftDevice
+// holds off application interrupts for longer than that, so RX is only
+// dependable with the SoftDevice disabled or idle. A lost edge is noticed
+// from the line level in most cases; the frame is then dropped and counted
+// as an overrun error, and reception picks up again after an idle frame
+// time. An even number of lost edges can still give a wrong byte.
+//
+// Each port needs a TIMER with six compare registers: NRF_TIMER3 or
+// NRF_TIMER4 (TIMER0 belongs to the SoftDevice and TIMER1/2 to Serial),
+// taken with timerReserve() together with its four PPI channels (2-5 with
+// TIMER3, 6-9 with TIMER4). It also uses two GPIOTE channels and EGU3 for
+// the RX edge interrupt.
+class SoftUart : public HardwareSerial
+{
+  public:
+    SoftUart(NRF_TIMER_Type *_timer, uint8_t _pinRX, uint8_t _pinTX);
+    void begin(unsigned long baudRate);
+    void begin(unsigned long baudrate, uint16_t config);
+    void end();
+    int available();
+    int peek();
+    int read();
+    void flush();
+    int availableForWrite();
+    size_t write(const uint8_t data);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write; // pull in write(str) and write(buf, size) from Print
+
+    // Counters as for Uart. The interrupt delay is that of the RX edge
+    // interrupt, taken from the edge timestamps.
+    SerialStats stats();
+    void resetStats();
+
+    void TimerIrqHandler();
+    void EdgeIrqHandler();
+
+    operator bool() { return index >= 0; }
+
+  private:
+    uint32_t now();
+    bool irqBlocked();
+    void txKick();
+    void txService();
+    void txRestart();
+    void txFill();
+    bool txArm(uint8_t slot);
+    int txNextEdge(uint32_t &when);
+    void rxEdge(uint32_t when, uint32_t gap);
+    void rxFill(uint8_t bit);
+    void rxFinish();
+    void rxLost(uint8_t level);
+
+    NRF_TIMER_Type *timer;
+    IRQn_Type timerIRQn;
+    int8_t index;                   // 0 for TIMER3, 1 for TIMER4, -1 if unusable
+    int8_t gpioteRX;
+    int8_t gpioteTX;
+    uint8_t ppiCh;                  // RX channel, followed by one per TX slot
+
+    RingBufferN<SOFTUART_RX_BUFFER_SIZE> rxBuffer;
+    RingBufferN<SOFTUART_TX_BUFFER_SIZE> txBuffer;
+    SerialStats counters;
+    uint32_t rxLagMax;              // longest edge interrupt delay, in timer ticks
+
+    uint32_t bitTicks[11];          // start of bit k from the start bit, 10 = frame end
+    uint32_t halfBitTicks;
+
+    // receiver, only touched at interrupt priority
+    uint32_t rxLastEdge;            // capture value of the last edge handled
+    uint32_t rxStart;               // time of the start bit edge
+    uint16_t rxFrame;
+    uint8_t rxBit;                  // bits of rxFrame filled in so far
+    uint8_t rxLevel;                // line level after the last edge
+    bool rxActive;
+    bool rxHunting;                 // waiting for an idle line after a lost edge
+
+    // transmitter, edges are generated from txFrame and handed to the slots
+    volatile bool txActive;
+    uint32_t txFrameStart;
+    uint16_t txFrame;
+    uint8_t txBit;                  // next bit of txFrame to look at
+    uint8_t txLevel;                // line level after the last generated edge
+    bool txEnding;                  // end of transmission has been queued
+    uint8_t txOldest;               // slot holding the earliest queued edge
+    uint8_t txCount;                // slots in use
+    uint8_t txSlotLevel[SOFTUART_TX_SLOTS];
+
+    uint8_t uc_pinRX;
+    uint8_t uc_pinTX;
+};
+
+#endif // NRF52
@@ -21,6 +21,12 @@
 #include "Arduino.h"
 #include "wiring_private.h"
 
+#ifdef NRF52
+// Smallest receive buffer worth starting when flow controlled; the next one
+// must be queued before a buffer this size fills up.
+#define SERIAL_RX_DMA_MIN 4
+#endif
+
 Uart::Uart(NRF_UART_Type *_nrfUart, IRQn_Type _IRQn, uint8_t _pinRX, uint8_t _pinTX)
 {
   nrfUart = _nrfUart;
@@ -28,6 +34,15 @@ Uart::Uart(NRF_UART_Type *_nrfUart, IRQn_Type _IRQn, uint8_t _pinRX, uint8_t _pi
   uc_pinRX = g_ADigitalPinMap[_pinRX];
   uc_pinTX = g_ADigitalPinMap[_pinTX];
   uc_hwFlow = 0;
+
+#ifdef NRF52
+  nrfUarte = (NRF_UARTE_Type *)_nrfUart;
+  baudrate = 0;
+  frameCallback = NULL;
+  frameIdleBits = 10;
+  frameTimer = NULL;
+  frameBuffer = NULL;
+#endif
 }
 
 Uart::Uart(NRF_UART_Type *_nrfUart, IRQn_Type _IRQn, uint8_t _pinRX, uint8_t _pinTX, uint8_t _pinCTS, uint8_t _pinRTS)
@@ -39,6 +54,15 @@ Uart::Uart(NRF_UART_Type *_nrfUart, IRQn_Type _IRQn, uint8_t _pinRX, uint8_t _pi
   uc_pinCTS = g_ADigitalPinMap[_pinCTS];
   uc_pinRTS = g_ADigitalPinMap[_pinRTS];
   uc_hwFlow = 1;
+
+#ifdef NRF52
+  nrfUarte = (NRF_UARTE_Type *)_nrfUart;
+  baudrate = 0;
+  frameCallback = NULL;
+  frameIdleBits = 10;
+  frameTimer = NULL;
+  frameBuffer = NULL;
+#endif
 }
 
 #ifdef ARDUINO_GENERIC
@@ -64,6 +88,10 @@ void Uart::begin(unsigned long baudrate)
 
 void Uart::begin(unsigned long baudrate, uint16_t /*config*/)
 {
+#ifdef NRF52
+  this->baudrate = baudrate;
+#endif
+
   nrfUart->PSELTXD = uc_pinTX;
   nrfUart->PSELRXD = uc_pinRX;
 
@@ -150,15 +178,64 @@ void Uart::begin(unsigned long baudrate, uint16_t /*config*/)
 
   nrfUart->BAUDRATE = nrfBaudRate;
 
+  txBuffer.clear();
+
+#ifdef NRF52
+  rxDmaIndex = 0;
+  rxDmaStart = 0;
+  rxDmaDrained = 0;
+  rxDmaStarted = false;
+  rxDrainSeen = 0;
+  txDmaCount = 0;
+
+  SERIAL_RX_COUNTER_TIMER->TASKS_STOP = 0x1UL;
+  SERIAL_RX_COUNTER_TIMER->MODE = TIMER_MODE_MODE_Counter;
+  SERIAL_RX_COUNTER_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  SERIAL_RX_COUNTER_TIMER->TASKS_CLEAR = 0x1UL;
+  SERIAL_RX_COUNTER_TIMER->TASKS_START = 0x1UL;
+
+  memset(&counters, 0, sizeof(counters));
+  rxCountBase = 0;
+  rxLagMax = 0;
+
+  // RXDRDY is not in NRF_UARTE_Type, but sits at the same offset as in UART
+  NRF_PPI->CH[SERIAL_RX_COUNTER_PPI_CH].EEP = (uint32_t)&nrfUart->EVENTS_RXDRDY;
+  NRF_PPI->CH[SERIAL_RX_COUNTER_PPI_CH].TEP = (uint32_t)&SERIAL_RX_COUNTER_TIMER->TASKS_COUNT;
+  NRF_PPI->CHENSET = (1UL << SERIAL_RX_COUNTER_PPI_CH);
+
+  nrfUarte->ENABLE = UARTE_ENABLE_ENABLE_Enabled;
+
+  nrfUarte->EVENTS_ENDRX = 0x0UL;
+  nrfUarte->EVENTS_RXSTARTED = 0x0UL;
+  nrfUarte->EVENTS_ERROR = 0x0UL;
+  nrfUarte->EVENTS_ENDTX = 0x0UL;
+
+  nrfUarte->INTENSET = UARTE_INTENSET_ENDRX_Msk | UARTE_INTENSET_RXSTARTED_Msk | UARTE_INTENSET_ERROR_Msk | UARTE_INTENSET_ENDTX_Msk;
+
+  rxPaused = true;
+  rxStopped = true;
+  rxResume();
+
+  if (frameTimer) {
+    frameTimer(this, true);
+  }
+#else
+  txBusy = false;
+  rxPaused = false;
+
+  memset(&counters, 0, sizeof(counters));
+
   nrfUart->ENABLE = UART_ENABLE_ENABLE_Enabled;
 
   nrfUart->EVENTS_RXDRDY = 0x0UL;
   nrfUart->EVENTS_TXDRDY = 0x0UL;
+  nrfUart->EVENTS_ERROR = 0x0UL;
 
   nrfUart->TASKS_STARTRX = 0x1UL;
   nrfUart->TASKS_STARTTX = 0x1UL;
 
-  nrfUart->INTENSET = UART_INTENSET_RXDRDY_Msk;
+  nrfUart->INTENSET = UART_INTENSET_RXDRDY_Msk | UART_INTENSET_TXDRDY_Msk | UART_INTENSET_ERROR_Msk;
+#endif
 
   NVIC_ClearPendingIRQ(IRQn);
   NVIC_SetPriority(IRQn, 3);
@@ -167,14 +244,41 @@ void Uart::begin(unsigned long baudrate, uint16_t /*config*/)
 
 void Uart::end()
 {
+  flush();
+
   NVIC_DisableIRQ(IRQn);
 
-  nrfUart->INTENCLR = UART_INTENCLR_RXDRDY_Msk;
+#ifdef NRF52
+  if (frameTimer) {
+    frameTimer(this, false);
+  }
+
+  nrfUarte->INTENCLR = UARTE_INTENCLR_ENDRX_Msk | UARTE_INTENCLR_RXSTARTED_Msk | UARTE_INTENCLR_ERROR_Msk | UARTE_INTENCLR_ENDTX_Msk;
+  nrfUarte->SHORTS = 0;
+
+  if (!rxStopped) {
+    nrfUarte->EVENTS_RXTO = 0x0UL;
+    nrfUarte->TASKS_STOPRX = 0x1UL;
+    while (!nrfUarte->EVENTS_RXTO);
+    nrfUarte->EVENTS_RXTO = 0x0UL;
+  }
+
+  nrfUarte->TASKS_STOPTX = 0x1UL;
+
+  nrfUarte->ENABLE = UARTE_ENABLE_ENABLE_Disabled;
+
+  NRF_PPI->CHENCLR = (1UL << SERIAL_RX_COUNTER_PPI_CH);
+  SERIAL_RX_COUNTER_TIMER->TASKS_STOP = 0x1UL;
+
+  baudrate = 0;
+#else
+  nrfUart->INTENCLR = UART_INTENCLR_RXDRDY_Msk | UART_INTENCLR_TXDRDY_Msk | UART_INTENCLR_ERROR_Msk;
 
   nrfUart->TASKS_STOPRX = 0x1UL;
   nrfUart->TASKS_STOPTX = 0x1UL;
 
   nrfUart->ENABLE = UART_ENABLE_ENABLE_Disabled;
+#endif
 
   nrfUart->PSELTXD = 0xFFFFFFFF;
   nrfUart->PSELRXD = 0xFFFFFFFF;
@@ -183,46 +287,578 @@ void Uart::end()
   nrfUart->PSELCTS = 0xFFFFFFFF;
 
   rxBuffer.clear();
+  txBuffer.clear();
 }
 
 void Uart::flush()
 {
+  // wait for the ring buffer to drain and the last byte to leave the wire
+#ifdef NRF52
+  while (txBuffer.available() || txDmaCount)
+#else
+  while (txBuffer.available() || txBusy)
+#endif
+  {
+    if (irqBlocked()) {
+      IrqHandler();
+    }
+  }
+}
+
+// True when the UART interrupt cannot preempt the caller, e.g. when writing
+// with interrupts disabled or from an ISR of equal or higher priority.
+// Such callers run the interrupt handler themselves while they wait.
+bool Uart::irqBlocked()
+{
+  if (__get_PRIMASK()) {
+    return true;
+  }
+
+  uint32_t ipsr = __get_IPSR();
+
+  if (ipsr == 0) {
+    return false;
+  } else if (ipsr < 16) {
+    return true;
+  }
+
+  return NVIC_GetPriority((IRQn_Type)(ipsr - 16)) <= NVIC_GetPriority(IRQn);
+}
+
+// Starts transmitting the buffered data if the transmitter is idle. Runs
+// with interrupts off, as a write() from a higher priority ISR could
+// otherwise start the same transfer twice.
+void Uart::txStart()
+{
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+
+#ifdef NRF52
+  if (txDmaCount || !txBuffer.available()) {
+    __set_PRIMASK(primask);
+    return;
+  }
+
+  // EasyDMA reads straight out of the ring buffer; the tail only moves on
+  // ENDTX, so the bytes in flight cannot be overwritten by write()
+  uint32_t count = txBuffer.contiguousAvailable();
+
+  if (count > 255) {
+    count = 255;
+  }
+
+  txDmaCount = count;
+
+  nrfUarte->TXD.PTR = (uint32_t)txBuffer.tailPtr();
+  nrfUarte->TXD.MAXCNT = count;
+  nrfUarte->TASKS_STARTTX = 0x1UL;
+#else
+  if (!txBusy && txBuffer.available()) {
+    txBusy = true;
+
+    nrfUart->TXD = txBuffer.read_char();
+  }
+#endif
+
+  __set_PRIMASK(primask);
 }
 
 void Uart::IrqHandler()
 {
+#ifdef NRF52
+  if (nrfUarte->EVENTS_ENDRX)
+  {
+    nrfUarte->EVENTS_ENDRX = 0x0UL;
+
+    uint32_t amount = nrfUarte->RXD.AMOUNT;
+
+    if (amount > rxDmaDrained) {
+      size_t wanted = amount - rxDmaDrained;
+
+      rxPut(&rxDmaBuffer[rxDmaIndex][rxDmaDrained], wanted);
+    }
+
+    // whatever the counter shows beyond this buffer came in while the
+    // interrupt was pending
+    SERIAL_RX_COUNTER_TIMER->TASKS_CAPTURE[1] = 0x1UL;
+    uint32_t lag = SERIAL_RX_COUNTER_TIMER->CC[1] - (rxDmaStart + amount);
+
+    if (lag > rxLagMax) {
+      rxLagMax = lag;
+    }
+
+    rxDmaStart += amount;
+    rxDmaDrained = 0;
+    rxDmaIndex ^= 1;
+
+    // no buffer was queued, so the receiver is now idle
+    if (rxPaused) {
+      rxStopped = true;
+      rxResume();
+    }
+  }
+
+  if (nrfUarte->EVENTS_RXSTARTED)
+  {
+    nrfUarte->EVENTS_RXSTARTED = 0x0UL;
+
+    rxDmaStarted = true;
+
+    // RXD.PTR and MAXCNT are double buffered, so the next buffer can be
+    // queued as soon as the current one has been latched. It only gets
+    // as much as the ring buffer can still take once the current one is in.
+    uint32_t count = rxDmaCredit(rxDmaMax[rxDmaIndex] - rxDmaDrained);
+
+    if (count >= SERIAL_RX_DMA_MIN) {
+      rxDmaMax[rxDmaIndex ^ 1] = count;
+
+      nrfUarte->RXD.PTR = (uint32_t)rxDmaBuffer[rxDmaIndex ^ 1];
+      nrfUarte->RXD.MAXCNT = count;
+    } else {
+      // let the receiver stop after this buffer; the UARTE then deasserts
+      // RTS once its FIFO fills
+      rxPaused = true;
+      nrfUarte->SHORTS = 0;
+    }
+  }
+
+  if (nrfUarte->EVENTS_ERROR)
+  {
+    nrfUarte->EVENTS_ERROR = 0x0UL;
+
+    uint32_t error = nrfUarte->ERRORSRC;
+    nrfUarte->ERRORSRC = error;
+
+    countErrors(error);
+  }
+
+  if (nrfUarte->EVENTS_ENDTX)
+  {
+    // a writer in a higher priority ISR may run this handler too
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    if (nrfUarte->EVENTS_ENDTX) {
+      nrfUarte->EVENTS_ENDTX = 0x0UL;
+
+      txBuffer.advanceTail(txDmaCount);
+      counters.txBytes += txDmaCount;
+      txDmaCount = 0;
+    }
+
+    __set_PRIMASK(primask);
+
+    txStart();
+  }
+
+#if __CORTEX_M == 0x04
+  volatile uint32_t dummy = nrfUarte->EVENTS_ENDRX;
+  (void)dummy;
+#endif
+#else
   if (nrfUart->EVENTS_RXDRDY)
   {
-    rxBuffer.store_char(nrfUart->RXD);
+    if (uc_hwFlow && rxBuffer.isFull()) {
+      // leave the byte in the UART's FIFO, which deasserts RTS when full;
+      // rxFlow() picks it up again
+      nrfUart->INTENCLR = UART_INTENCLR_RXDRDY_Msk;
+      rxPaused = true;
+    } else {
+      uint8_t c = nrfUart->RXD;
+
+      nrfUart->EVENTS_RXDRDY = 0x0UL;
+
+      bool full = rxBuffer.isFull();
+
+      rxBuffer.store_char(c);
+
+      counters.rxBytes++;
+      rxStored(1, full ? 0 : 1);
+    }
+  }
+
+  if (nrfUart->EVENTS_ERROR)
+  {
+    nrfUart->EVENTS_ERROR = 0x0UL;
 
-    nrfUart->EVENTS_RXDRDY = 0x0UL;
+    uint32_t error = nrfUart->ERRORSRC;
+    nrfUart->ERRORSRC = error;
+
+    countErrors(error);
+  }
+
+  if (nrfUart->EVENTS_TXDRDY)
+  {
+    // a writer in a higher priority ISR may run this handler too
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    if (nrfUart->EVENTS_TXDRDY) {
+      nrfUart->EVENTS_TXDRDY = 0x0UL;
+
+      txBusy = false;
+      counters.txBytes++;
+    }
+
+    __set_PRIMASK(primask);
+
+    txStart();
   }
+#endif
+}
+
+#ifdef NRF52
+// Moves the bytes EasyDMA has already written to the active buffer out,
+// without waiting for the buffer to fill up. They go straight to data when
+// one is given and the ring buffer is empty (so ordering is kept), and into
+// the ring buffer otherwise. Returns the number of bytes copied to data.
+size_t Uart::rxDrain(uint8_t *data, size_t length)
+{
+  size_t copied = 0;
+
+  if (nrfUarte->ENABLE != UARTE_ENABLE_ENABLE_Enabled || rxStopped) {
+    return 0;
+  }
+
+  NVIC_DisableIRQ(IRQn);
+
+  // bytes waiting in the FIFO after a pause were counted before STARTRX
+  // moves them
+  if (!rxDmaStarted) {
+    NVIC_EnableIRQ(IRQn);
+    return 0;
+  }
+
+  SERIAL_RX_COUNTER_TIMER->TASKS_CAPTURE[0] = 0x1UL;
+  uint32_t counted = SERIAL_RX_COUNTER_TIMER->CC[0];
+
+  // RXDRDY can come before EasyDMA has stored the byte, so the newest one
+  // is left for ENDRX or the next look, unless it was already counted at
+  // the last one
+  uint32_t landed = (counted == rxDrainSeen) ? counted : counted - 1;
+  rxDrainSeen = counted;
+
+  uint32_t received = landed - rxDmaStart;
+
+  // the held back byte may be the first one of this buffer
+  if ((int32_t)received < 0) {
+    received = 0;
+  }
+
+  // an unhandled ENDRX means the rest already belongs to the next buffer
+  if (received > rxDmaMax[rxDmaIndex]) {
+    received = rxDmaMax[rxDmaIndex];
+  }
+
+  if (data && received > rxDmaDrained && !rxBuffer.available()) {
+    copied = received - rxDmaDrained;
+
+    if (copied > length) {
+      copied = length;
+    }
+
+    memcpy(data, &rxDmaBuffer[rxDmaIndex][rxDmaDrained], copied);
+    rxDmaDrained += copied;
+  }
+
+  if (received > rxDmaDrained) {
+    size_t wanted = received - rxDmaDrained;
+
+    rxPut(&rxDmaBuffer[rxDmaIndex][rxDmaDrained], wanted);
+    rxDmaDrained = received;
+  }
+
+  NVIC_EnableIRQ(IRQn);
+
+  return copied;
+}
+
+// Bytes the next receive buffer may take, given those still pending in the
+// current one. Without flow control the ring buffer simply drops what does
+// not fit, so the buffer is always used in full.
+uint32_t Uart::rxDmaCredit(uint32_t pending)
+{
+  if (!uc_hwFlow || frameBuffer) {
+    return SERIAL_RX_DMA_SIZE;
+  }
+
+  uint32_t space = rxBuffer.availableForStore();
+
+  if (space <= pending) {
+    return 0;
+  }
+
+  space -= pending;
+
+  return (space < SERIAL_RX_DMA_SIZE) ? space : SERIAL_RX_DMA_SIZE;
+}
+
+// Restarts a stopped receiver once the low watermark is reached. Runs in
+// the ISR or with the UART interrupt masked.
+void Uart::rxResume()
+{
+  if (!rxStopped) {
+    return;
+  }
+
+  if (uc_hwFlow && rxBuffer.availableForStore() < SERIAL_RX_FLOW_RESUME) {
+    return;
+  }
+
+  uint32_t count = rxDmaCredit(0);
+
+  if (count < SERIAL_RX_DMA_MIN) {
+    return;
+  }
+
+  rxPaused = false;
+  rxStopped = false;
+  rxDmaStarted = false;
+
+  // Ping-pong between the two DMA buffers: ENDRX restarts reception straight
+  // away through the shortcut, and each RXSTARTED queues the other buffer.
+  rxDmaMax[rxDmaIndex] = count;
+
+  nrfUarte->RXD.PTR = (uint32_t)rxDmaBuffer[rxDmaIndex];
+  nrfUarte->RXD.MAXCNT = count;
+  nrfUarte->SHORTS = UARTE_SHORTS_ENDRX_STARTRX_Msk;
+
+  nrfUarte->TASKS_STARTRX = 0x1UL;
+}
+
+#endif
+
+// Lets a receiver held off by flow control go again once the reader has
+// made room.
+void Uart::rxFlow()
+{
+  if (!rxPaused) {
+    return;
+  }
+
+  NVIC_DisableIRQ(IRQn);
+
+#ifdef NRF52
+  if (rxStopped) {
+    rxResume();
+  }
+#else
+  if (rxPaused && rxBuffer.availableForStore() >= SERIAL_RX_FLOW_RESUME) {
+    rxPaused = false;
+    nrfUart->INTENSET = UART_INTENSET_RXDRDY_Msk;
+  }
+#endif
+
+  NVIC_EnableIRQ(IRQn);
+}
+
+// Book-keeping for bytes put in the RX buffer.
+void Uart::rxStored(size_t wanted, size_t stored)
+{
+  counters.rxDropped += wanted - stored;
+
+  uint32_t used = rxBuffer.available();
+
+  if (used > counters.rxPeak) {
+    counters.rxPeak = used;
+  }
+}
+
+#ifdef NRF52
+// Puts received bytes in the frame buffer in frame mode, and in the ring
+// buffer otherwise.
+void Uart::rxPut(const uint8_t *data, size_t length)
+{
+  if (frameBuffer) {
+    size_t room = SERIAL_FRAME_BUFFER_SIZE - frameStored;
+    size_t stored = (length < room) ? length : room;
+
+    memcpy(frameBuffer + frameStored, data, stored);
+    frameStored += stored;
+
+    counters.rxDropped += length - stored;
+
+    if (frameStored > counters.rxPeak) {
+      counters.rxPeak = frameStored;
+    }
+    return;
+  }
+
+  rxStored(length, rxBuffer.write(data, length));
+}
+#endif
+
+void Uart::countErrors(uint32_t errors)
+{
+  if (errors & UART_ERRORSRC_OVERRUN_Msk) {
+    counters.overrunErrors++;
+  }
+  if (errors & UART_ERRORSRC_PARITY_Msk) {
+    counters.parityErrors++;
+  }
+  if (errors & UART_ERRORSRC_FRAMING_Msk) {
+    counters.framingErrors++;
+  }
+  if (errors & UART_ERRORSRC_BREAK_Msk) {
+    counters.breaks++;
+  }
+}
+
+// The counters are updated from the ISR without locking; a copy may be a
+// count or two apart between fields, which is fine for statistics.
+SerialStats Uart::stats()
+{
+  SerialStats s = counters;
+
+#ifdef NRF52
+  // received bytes are counted by the hardware
+  SERIAL_RX_COUNTER_TIMER->TASKS_CAPTURE[1] = 0x1UL;
+  s.rxBytes = SERIAL_RX_COUNTER_TIMER->CC[1] - rxCountBase;
+
+  // 10 bit times per character; no latency to report when closed
+  if (baudrate) {
+    s.maxIrqLatency = ((uint64_t)rxLagMax * 10000000UL) / baudrate;
+  } else {
+    s.maxIrqLatency = 0;
+  }
+#endif
+
+  return s;
+}
+
+void Uart::resetStats()
+{
+  memset(&counters, 0, sizeof(counters));
+
+#ifdef NRF52
+  SERIAL_RX_COUNTER_TIMER->TASKS_CAPTURE[1] = 0x1UL;
+  rxCountBase = SERIAL_RX_COUNTER_TIMER->CC[1];
+  rxLagMax = 0;
+#endif
 }
 
 int Uart::available()
 {
+#ifdef NRF52
+  if (frameCallback) {
+    return 0;
+  }
+
+  rxDrain();
+#endif
+
   return rxBuffer.available();
 }
 
 int Uart::peek()
 {
+#ifdef NRF52
+  if (frameCallback) {
+    return -1;
+  }
+
+  if (!rxBuffer.available()) {
+    rxDrain();
+  }
+#endif
+
   return rxBuffer.peek();
 }
 
 int Uart::read()
 {
-  return rxBuffer.read_char();
+#ifdef NRF52
+  if (frameCallback) {
+    return -1;
+  }
+
+  if (!rxBuffer.available()) {
+    rxDrain();
+  }
+#endif
+
+  int c = rxBuffer.read_char();
+
+  rxFlow();
+
+  return c;
+}
+
+size_t Uart::readBytes(char *buffer, size_t length)
+{
+  uint8_t *data = (uint8_t *)buffer;
+  size_t count = 0;
+
+#ifdef NRF52
+  if (frameCallback) {
+    return 0;
+  }
+#endif
+
+  // copy whole runs at a time, and only look at the clock while waiting
+  _startMillis = millis();
+
+  while (count < length) {
+    size_t n = rxBuffer.read(data + count, length - count);
+
+#ifdef NRF52
+    if (count + n < length) {
+      n += rxDrain(data + count + n, length - count - n);
+    }
+#endif
+
+    if (n) {
+      count += n;
+      _startMillis = millis();
+
+      rxFlow();
+    } else if (millis() - _startMillis >= _timeout) {
+      break;
+    }
+  }
+
+  return count;
+}
+
+int Uart::availableForWrite()
+{
+  return txBuffer.availableForStore();
 }
 
+// write() may be called from thread code and from ISRs alike. txBuffer
+// only takes one producer at a time, so storing is done with interrupts
+// off.
 size_t Uart::write(const uint8_t data)
 {
-  nrfUart->TXD = data;
+  return write(&data, 1);
+}
+
+size_t Uart::write(const uint8_t *buffer, size_t size)
+{
+  size_t count = 0;
 
-  while(!nrfUart->EVENTS_TXDRDY);
+  while (count < size) {
+    uint32_t primask = __get_PRIMASK();
 
-  nrfUart->EVENTS_TXDRDY = 0x0UL;
+    __disable_irq();
+    size_t n = txBuffer.write(buffer + count, size - count);
+    __set_PRIMASK(primask);
+
+    count += n;
+
+    txStart();
+
+    // only wait when the buffer is full; if the interrupt cannot run from
+    // here, service the transmitter directly
+    if (!n && irqBlocked()) {
+      IrqHandler();
+    }
+  }
 
-  return 1;
+  return size;
 }
 
 #if defined(NRF52)
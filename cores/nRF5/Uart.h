@@ -23,9 +23,48 @@
 
 #include "HardwareSerial.h"
 #include "RingBuffer.h"
+#include "variant.h"
 
 #include <cstddef>
 
+// Ring buffer sizes, may be overridden by the variant or build flags.
+// Both must be powers of two.
+#ifndef SERIAL_RX_BUFFER_SIZE
+#define SERIAL_RX_BUFFER_SIZE SERIAL_BUFFER_SIZE
+#endif
+#ifndef SERIAL_TX_BUFFER_SIZE
+#define SERIAL_TX_BUFFER_SIZE SERIAL_BUFFER_SIZE
+#endif
+
+// With hardware flow control, reception is held off (RTS deasserted) once
+// the RX ring buffer is full, and resumed when this many bytes are free.
+#ifndef SERIAL_RX_FLOW_RESUME
+#define SERIAL_RX_FLOW_RESUME (SERIAL_RX_BUFFER_SIZE / 2)
+#endif
+
+#ifdef NRF52
+// Size of each of the two EasyDMA receive buffers. Bytes are moved into the
+// ring buffer once per filled buffer, or on demand when the sketch reads.
+#ifndef SERIAL_RX_DMA_SIZE
+#define SERIAL_RX_DMA_SIZE 128
+#endif
+
+// Largest frame onFrame() can deliver; 256 fits any Modbus RTU frame.
+// Bytes past it are dropped and counted in rxDropped.
+#ifndef SERIAL_FRAME_BUFFER_SIZE
+#define SERIAL_FRAME_BUFFER_SIZE 256
+#endif
+
+// TIMER (in counter mode) and PPI channel used to count received bytes, so
+// data in a partially filled DMA buffer can be read before ENDRX.
+#ifndef SERIAL_RX_COUNTER_TIMER
+#define SERIAL_RX_COUNTER_TIMER  NRF_TIMER1
+#endif
+#ifndef SERIAL_RX_COUNTER_PPI_CH
+#define SERIAL_RX_COUNTER_PPI_CH 0
+#endif
+#endif
+
 class Uart : public HardwareSerial
 {
   public:
@@ -42,16 +81,82 @@ class Uart : public HardwareSerial
     int peek();
     int read();
     void flush();
+    int availableForWrite();
     size_t write(const uint8_t data);
+    size_t write(const uint8_t *buffer, size_t size);
     using Print::write; // pull in write(str) and write(buf, size) from Print
+    size_t readBytes(char *buffer, size_t length);
+    using Stream::readBytes; // pull in readBytes(uint8_t *, size) from Stream
+
+    // Counters for sizing buffers and baud rates. The interrupt delay is
+    // measured in whole characters on nRF52 (by how far reception has run
+    // past a full DMA buffer) and is not measured on nRF51.
+    SerialStats stats();
+    void resetStats();
 
     void IrqHandler();
 
+#ifdef NRF52
+    // Calls callback with each frame once the line has been idle for
+    // idleBits bit times (10 is one 8N1 character, 35 suits Modbus RTU).
+    // Frames are collected in a buffer of SERIAL_FRAME_BUFFER_SIZE bytes;
+    // longer ones are cut short and the rest is counted as dropped. The
+    // data is only valid during the callback, which runs in interrupt
+    // context. While a callback is attached, received data is handed out
+    // only through it, and available()/read() see nothing. Pass NULL to
+    // go back to normal reads.
+    void onFrame(void (*callback)(const uint8_t *data, size_t length), uint16_t idleBits = 10);
+    void IdleIrqHandler();
+#endif
+
     operator bool() { return true; }
 
   private:
+    void txStart();
+    bool irqBlocked();
+    void rxFlow();
+    void rxStored(size_t wanted, size_t stored);
+    void countErrors(uint32_t errors);
+
     NRF_UART_Type *nrfUart;
-    RingBuffer rxBuffer;
+    RingBufferN<SERIAL_RX_BUFFER_SIZE> rxBuffer;
+    RingBufferN<SERIAL_TX_BUFFER_SIZE> txBuffer;
+    SerialStats counters;
+
+#ifdef NRF52
+    size_t rxDrain(uint8_t *data = NULL, size_t length = 0);
+    void rxPut(const uint8_t *data, size_t length);
+    uint32_t rxDmaCredit(uint32_t pending);
+    void rxResume();
+    void idleStart();
+    void idleStop();
+    static void idleSwitch(Uart *uart, bool on);
+
+    NRF_UARTE_Type *nrfUarte;
+    uint8_t rxDmaBuffer[2][SERIAL_RX_DMA_SIZE];
+    volatile uint8_t rxDmaIndex;     // buffer currently being filled by EasyDMA
+    volatile uint32_t rxDmaStart;    // RXDRDY count when that buffer started
+    volatile uint32_t rxDmaDrained;  // bytes of that buffer already moved out
+    uint16_t rxDmaMax[2];            // MAXCNT each buffer was started with
+    volatile bool rxStopped;         // paused, and the last buffer has ended
+    volatile bool rxDmaStarted;      // RXSTARTED seen since the last resume
+    uint32_t rxDrainSeen;            // RX counter value at the last rxDrain()
+    volatile uint32_t txDmaCount;    // bytes handed to EasyDMA, 0 when idle
+
+    unsigned long baudrate;
+    void (*frameCallback)(const uint8_t *data, size_t length);
+    uint16_t frameIdleBits;
+    // set by onFrame(), so the frame code is only linked in when used
+    void (*frameTimer)(Uart *uart, bool on);
+    uint8_t *frameBuffer;            // received data goes here in frame mode
+    size_t frameStored;              // bytes in frameBuffer
+    uint32_t frameStart;             // RX counter value at the start of the frame
+    uint32_t rxCountBase;            // RX counter value at the last reset
+    uint32_t rxLagMax;               // most bytes received past an ENDRX before it was handled
+#else
+    volatile bool txBusy;
+#endif
+    volatile bool rxPaused;          // no more room, waiting for the reader
 
     IRQn_Type IRQn;
 
@@ -0,0 +1,178 @@
+/*
+  Copyright (c) 2015 Arduino LLC.  All right reserved.
+  Copyright (c) 2016 Sandeep Mistry All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// Frame reception (onFrame). It lives apart from Uart.cpp so that the
+// TIMER2 handler is only linked in by sketches that call onFrame(); the
+// others can still define TIMER2_IRQHandler themselves.
+
+#ifdef NRF52
+
+#include "Uart.h"
+#include "Arduino.h"
+#include "wiring_private.h"
+
+// TIMER and PPI channel used for frame idle detection. Every received byte
+// clears the free running timer through the fork of the RX counter's PPI
+// channel. Its compare event marks an idle line and, through this channel,
+// latches the RX count there as the end of the frame.
+#ifndef SERIAL_IDLE_TIMER
+#define SERIAL_IDLE_TIMER        NRF_TIMER2
+#define SERIAL_IDLE_TIMER_IRQn   TIMER2_IRQn
+#endif
+#ifndef SERIAL_IDLE_PPI_CH
+#define SERIAL_IDLE_PPI_CH       1
+#endif
+
+// RX counter capture register holding the end of the last frame
+#define SERIAL_FRAME_END_CC      2
+
+static uint8_t serialFrameBuffer[SERIAL_FRAME_BUFFER_SIZE];
+
+void Uart::onFrame(void (*callback)(const uint8_t *data, size_t length), uint16_t idleBits)
+{
+  bool running = (nrfUarte->ENABLE == UARTE_ENABLE_ENABLE_Enabled);
+
+  if (running) {
+    idleStop();
+    NVIC_DisableIRQ(IRQn);
+  }
+
+  frameCallback = callback;
+  frameIdleBits = idleBits;
+  frameTimer = callback ? idleSwitch : NULL;
+  frameBuffer = callback ? serialFrameBuffer : NULL;
+
+  if (running) {
+    if (frameCallback) {
+      idleStart();
+    }
+    NVIC_EnableIRQ(IRQn);
+  }
+}
+
+void Uart::idleSwitch(Uart *uart, bool on)
+{
+  if (on) {
+    uart->idleStart();
+  } else {
+    uart->idleStop();
+  }
+}
+
+void Uart::idleStart()
+{
+  // 1 MHz tick
+  uint32_t ticks = ((uint64_t)frameIdleBits * 1000000UL) / baudrate;
+
+  if (ticks == 0) {
+    ticks = 1;
+  }
+
+  // the next frame starts with the next byte not yet put anywhere
+  frameStored = 0;
+  frameStart = rxDmaStart + rxDmaDrained;
+
+  SERIAL_IDLE_TIMER->TASKS_STOP = 0x1UL;
+  SERIAL_IDLE_TIMER->MODE = TIMER_MODE_MODE_Timer;
+  SERIAL_IDLE_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  SERIAL_IDLE_TIMER->PRESCALER = 4;
+  SERIAL_IDLE_TIMER->TASKS_CLEAR = 0x1UL;
+  SERIAL_IDLE_TIMER->CC[0] = ticks;
+  SERIAL_IDLE_TIMER->EVENTS_COMPARE[0] = 0x0UL;
+  SERIAL_IDLE_TIMER->SHORTS = 0;
+  SERIAL_IDLE_TIMER->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+
+  NRF_PPI->FORK[SERIAL_RX_COUNTER_PPI_CH].TEP = (uint32_t)&SERIAL_IDLE_TIMER->TASKS_CLEAR;
+
+  NRF_PPI->CH[SERIAL_IDLE_PPI_CH].EEP = (uint32_t)&SERIAL_IDLE_TIMER->EVENTS_COMPARE[0];
+  NRF_PPI->CH[SERIAL_IDLE_PPI_CH].TEP = (uint32_t)&SERIAL_RX_COUNTER_TIMER->TASKS_CAPTURE[SERIAL_FRAME_END_CC];
+  NRF_PPI->CHENSET = (1UL << SERIAL_IDLE_PPI_CH);
+
+  NVIC_ClearPendingIRQ(SERIAL_IDLE_TIMER_IRQn);
+  NVIC_SetPriority(SERIAL_IDLE_TIMER_IRQn, 3);
+  NVIC_EnableIRQ(SERIAL_IDLE_TIMER_IRQn);
+
+  // an idle line without data gives an empty frame, which is skipped
+  SERIAL_IDLE_TIMER->TASKS_START = 0x1UL;
+}
+
+void Uart::idleStop()
+{
+  if (!frameCallback) {
+    return;
+  }
+
+  NRF_PPI->CHENCLR = (1UL << SERIAL_IDLE_PPI_CH);
+  NRF_PPI->FORK[SERIAL_RX_COUNTER_PPI_CH].TEP = 0;
+
+  NVIC_DisableIRQ(SERIAL_IDLE_TIMER_IRQn);
+
+  SERIAL_IDLE_TIMER->INTENCLR = TIMER_INTENSET_COMPARE0_Msk;
+  SERIAL_IDLE_TIMER->TASKS_STOP = 0x1UL;
+}
+
+void Uart::IdleIrqHandler()
+{
+  if (SERIAL_IDLE_TIMER->EVENTS_COMPARE[0])
+  {
+    SERIAL_IDLE_TIMER->EVENTS_COMPARE[0] = 0x0UL;
+
+#if __CORTEX_M == 0x04
+    volatile uint32_t dummy = SERIAL_IDLE_TIMER->EVENTS_COMPARE[0];
+    (void)dummy;
+#endif
+
+    // Bytes up to the end latched at the compare are in RAM by now, as the
+    // line was idle after them. More may have come in since, if this ran
+    // late; they belong to the next frame.
+    uint32_t end = SERIAL_RX_COUNTER_TIMER->CC[SERIAL_FRAME_END_CC];
+
+    rxDrainSeen = end;
+    rxDrain();
+
+    size_t length = end - frameStart;
+
+    // the rest of an oversized frame was dropped
+    if (length > frameStored) {
+      length = frameStored;
+    }
+
+    if (length && frameCallback) {
+      frameCallback(frameBuffer, length);
+    }
+
+    frameStored -= length;
+    memmove(frameBuffer, frameBuffer + length, frameStored);
+    frameStart = end;
+
+    if (rxStopped) {
+      rxResume();
+    }
+  }
+}
+
+extern "C"
+{
+  void TIMER2_IRQHandler()
+  {
+    Serial.IdleIrqHandler();
+  }
+}
+
+#endif
@@ -30,6 +30,9 @@
 #define NUMBER_OF_GPIO_TE 4
 #endif
 
+// channelMap value of a channel reserved by a core driver
+#define GPIOTE_RESERVED -2
+
 static voidFuncPtr callbacksInt[NUMBER_OF_GPIO_TE];
 static int8_t channelMap[NUMBER_OF_GPIO_TE];
 static int enabled = 0;
@@ -46,6 +49,42 @@ static void __initialize()
   NVIC_EnableIRQ(GPIOTE_IRQn);
 }
 
+/*
+ * \brief Reserves a GPIOTE channel for a core driver, so attachInterrupt()
+ *        will not hand it out. Channels are taken from the top down, while
+ *        attachInterrupt() allocates from the bottom up.
+ */
+int gpioteReserve(void)
+{
+  if (!enabled) {
+    __initialize();
+    enabled = 1;
+  }
+
+  for (int ch = NUMBER_OF_GPIO_TE - 1; ch >= 0; ch--) {
+    if (channelMap[ch] == -1) {
+      channelMap[ch] = GPIOTE_RESERVED;
+
+      return ch;
+    }
+  }
+
+  return -1;
+}
+
+/*
+ * \brief Returns a channel taken with gpioteReserve().
+ */
+void gpioteRelease(int ch)
+{
+  if (ch < 0 || ch >= NUMBER_OF_GPIO_TE || channelMap[ch] != GPIOTE_RESERVED) {
+    return;
+  }
+
+  NRF_GPIOTE->CONFIG[ch] = 0;
+  channelMap[ch] = -1;
+}
+
 /*
  * \brief Specifies a named Interrupt Service Routine (ISR) to call when an interrupt occurs.
  *        Replaces any previous function that was attached to the interrupt.
@@ -89,6 +89,35 @@ extern void analogWriteResolution(int res);
 
 extern void analogOutputInit( void ) ;
 
+#ifdef NRF52
+#include <stdbool.h>
+#include <stddef.h>
+#include "nrf.h"
+
+/*
+ * \brief Called from the SAADC interrupt with each full buffer of a stream.
+ * The samples are raw SAADC results at the resolution set by analogReadResolution()
+ * (rounded up to 8, 10, 12 or 14 bits) and can dip slightly below zero. The buffer
+ * is filled again once the other one is full, so the callback must be done by then.
+ */
+typedef void (*analogStreamCallback)( int16_t *samples, size_t count, void *arg ) ;
+
+/*
+ * \brief Samples a pin continuously at sampleRate (up to 200000 per second) into
+ * two alternating buffers of count samples, without CPU work per sample.
+ * analogRead() returns 0 until analogStreamStop().
+ *
+ * \param timer NRF_TIMER3 or NRF_TIMER4, which SoftUart then cannot use
+ *
+ * \return false if the pin has no analog input or the arguments are out of range.
+ */
+extern bool analogStreamStart( uint32_t ulPin, NRF_TIMER_Type *timer, uint32_t sampleRate,
+                               int16_t *buf0, int16_t *buf1, size_t count,
+                               analogStreamCallback callback, void *arg ) ;
+
+extern void analogStreamStop( void ) ;
+#endif
+
 #ifdef __cplusplus
 }
 #endif
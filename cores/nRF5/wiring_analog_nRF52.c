@@ -49,6 +49,23 @@ static uint16_t pwmChannelSequence[PWM_COUNT];
 static int readResolution = 10;
 static int writeResolution = 8;
 
+// Conversion (2 us) plus the shortest acquisition time (3 us)
+#define ANALOG_STREAM_MAX_RATE 200000
+
+// RESULT.MAXCNT is 15 bits
+#define ANALOG_STREAM_MAX_COUNT 0x7FFF
+
+// The stream takes its timer with timerReserve(), and the first two of the
+// PPI channels that come with it: one connects the timer to SAMPLE, the
+// other END to START.
+static NRF_TIMER_Type *streamTimer;
+static int streamPpiCh;
+static int16_t *streamBufs[2];
+static size_t streamCount;
+static uint8_t streamFill;
+static analogStreamCallback streamCallback;
+static void *streamArg;
+
 void analogReadResolution( int res )
 {
   readResolution = res;
@@ -99,72 +116,62 @@ void analogReference( eAnalogReference ulMode )
   }
 }
 
-uint32_t analogRead( uint32_t ulPin )
+static uint32_t saadcPin( uint32_t ulPin )
 {
-  uint32_t pin = SAADC_CH_PSELP_PSELP_NC;
-  uint32_t saadcResolution;
-  uint32_t resolution;
-  int16_t value;
-
   if (ulPin >= PINS_COUNT) {
-    return 0;
+    return SAADC_CH_PSELP_PSELP_NC;
   }
 
-  ulPin = g_ADigitalPinMap[ulPin];
-
-  switch ( ulPin ) {
+  switch ( g_ADigitalPinMap[ulPin] ) {
     case 2:
-      pin = SAADC_CH_PSELP_PSELP_AnalogInput0;
-      break;
+      return SAADC_CH_PSELP_PSELP_AnalogInput0;
 
     case 3:
-      pin = SAADC_CH_PSELP_PSELP_AnalogInput1;
-      break;
+      return SAADC_CH_PSELP_PSELP_AnalogInput1;
 
     case 4:
-      pin = SAADC_CH_PSELP_PSELP_AnalogInput2;
-      break;
+      return SAADC_CH_PSELP_PSELP_AnalogInput2;
 
     case 5:
-      pin = SAADC_CH_PSELP_PSELP_AnalogInput3;
-      break;
+      return SAADC_CH_PSELP_PSELP_AnalogInput3;
 
     case 28:
-      pin = SAADC_CH_PSELP_PSELP_AnalogInput4;
-      break;
+      return SAADC_CH_PSELP_PSELP_AnalogInput4;
 
     case 29:
-      pin = SAADC_CH_PSELP_PSELP_AnalogInput5;
-      break;
+      return SAADC_CH_PSELP_PSELP_AnalogInput5;
 
     case 30:
-      pin = SAADC_CH_PSELP_PSELP_AnalogInput6;
-      break;
+      return SAADC_CH_PSELP_PSELP_AnalogInput6;
 
     case 31:
-      pin = SAADC_CH_PSELP_PSELP_AnalogInput7;
-      break;
+      return SAADC_CH_PSELP_PSELP_AnalogInput7;
 
     default:
-      return 0;
+      return SAADC_CH_PSELP_PSELP_NC;
   }
+}
 
+static uint32_t saadcResolution( uint32_t *resolution )
+{
   if (readResolution <= 8) {
-    resolution = 8;
-    saadcResolution = SAADC_RESOLUTION_VAL_8bit;
+    *resolution = 8;
+    return SAADC_RESOLUTION_VAL_8bit;
   } else if (readResolution <= 10) {
-    resolution = 10;
-    saadcResolution = SAADC_RESOLUTION_VAL_10bit;
+    *resolution = 10;
+    return SAADC_RESOLUTION_VAL_10bit;
   } else if (readResolution <= 12) {
-    resolution = 12;
-    saadcResolution = SAADC_RESOLUTION_VAL_12bit;
+    *resolution = 12;
+    return SAADC_RESOLUTION_VAL_12bit;
   } else {
-    resolution = 14;
-    saadcResolution = SAADC_RESOLUTION_VAL_14bit;
+    *resolution = 14;
+    return SAADC_RESOLUTION_VAL_14bit;
   }
+}
 
-  NRF_SAADC->RESOLUTION = saadcResolution;
-
+// Enables the SAADC with channel 0 on pin and all others off
+static void saadcEnable( uint32_t pin )
+{
   NRF_SAADC->ENABLE = (SAADC_ENABLE_ENABLE_Enabled << SAADC_ENABLE_ENABLE_Pos);
   for (int i = 0; i < 8; i++) {
     NRF_SAADC->CH[i].PSELN = SAADC_CH_PSELP_PSELP_NC;
@@ -178,7 +185,22 @@ uint32_t analogRead( uint32_t ulPin )
                             | ((SAADC_CH_CONFIG_MODE_SE       << SAADC_CH_CONFIG_MODE_Pos)   & SAADC_CH_CONFIG_MODE_Msk);
   NRF_SAADC->CH[0].PSELN = pin;
   NRF_SAADC->CH[0].PSELP = pin;
+}
+
+uint32_t analogRead( uint32_t ulPin )
+{
+  uint32_t pin = saadcPin(ulPin);
+  uint32_t resolution;
+  int16_t value;
+
+  // the SAADC belongs to the stream
+  if (pin == SAADC_CH_PSELP_PSELP_NC || streamTimer) {
+    return 0;
+  }
+
+  NRF_SAADC->RESOLUTION = saadcResolution(&resolution);
 
+  saadcEnable(pin);
 
   NRF_SAADC->RESULT.PTR = (uint32_t)&value;
   NRF_SAADC->RESULT.MAXCNT = 1; // One sample
@@ -207,6 +229,137 @@ uint32_t analogRead( uint32_t ulPin )
   return mapResolution(value, resolution, readResolution);
 }
 
+bool analogStreamStart( uint32_t ulPin, NRF_TIMER_Type *timer, uint32_t sampleRate,
+                        int16_t *buf0, int16_t *buf1, size_t count,
+                        analogStreamCallback callback, void *arg )
+{
+  uint32_t pin = saadcPin(ulPin);
+  uint32_t resolution;
+  int ppiCh;
+
+  if (pin == SAADC_CH_PSELP_PSELP_NC || sampleRate == 0 || sampleRate > ANALOG_STREAM_MAX_RATE ||
+      !buf0 || !buf1 || count == 0 || count > ANALOG_STREAM_MAX_COUNT) {
+    return false;
+  }
+
+  analogStreamStop();
+
+  // fails while SoftUart or SPI has the timer
+  ppiCh = timerReserve(timer);
+
+  if (ppiCh < 0) {
+    return false;
+  }
+
+  streamTimer = timer;
+  streamPpiCh = ppiCh;
+  streamBufs[0] = buf0;
+  streamBufs[1] = buf1;
+  streamCount = count;
+  streamFill = 0;
+  streamCallback = callback;
+  streamArg = arg;
+
+  NRF_SAADC->INTENCLR = 0xFFFFFFFFUL;
+  NRF_SAADC->RESOLUTION = saadcResolution(&resolution);
+  NRF_SAADC->OVERSAMPLE = SAADC_OVERSAMPLE_OVERSAMPLE_Bypass;
+  NRF_SAADC->SAMPLERATE = (SAADC_SAMPLERATE_MODE_Task << SAADC_SAMPLERATE_MODE_Pos);
+
+  saadcEnable(pin);
+
+  timer->TASKS_STOP = 0x1UL;
+  timer->INTENCLR = 0xFFFFFFFFUL;
+  timer->MODE = TIMER_MODE_MODE_Timer;
+  timer->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  timer->PRESCALER = 0;
+  timer->CC[0] = (16000000UL + sampleRate / 2) / sampleRate;
+  timer->SHORTS = TIMER_SHORTS_COMPARE0_CLEAR_Msk;
+  timer->TASKS_CLEAR = 0x1UL;
+  timer->EVENTS_COMPARE[0] = 0x0UL;
+
+  NRF_PPI->CH[ppiCh].EEP = (uint32_t)&timer->EVENTS_COMPARE[0];
+  NRF_PPI->CH[ppiCh].TEP = (uint32_t)&NRF_SAADC->TASKS_SAMPLE;
+
+  // RESULT.PTR is double buffered: the next buffer is set while this one
+  // fills, and END starts it in hardware
+  NRF_PPI->CH[ppiCh + 1].EEP = (uint32_t)&NRF_SAADC->EVENTS_END;
+  NRF_PPI->CH[ppiCh + 1].TEP = (uint32_t)&NRF_SAADC->TASKS_START;
+
+  NRF_SAADC->RESULT.PTR = (uint32_t)buf0;
+  NRF_SAADC->RESULT.MAXCNT = count;
+
+  NRF_SAADC->EVENTS_STARTED = 0x0UL;
+  NRF_SAADC->EVENTS_END = 0x0UL;
+  NRF_SAADC->EVENTS_STOPPED = 0x0UL;
+
+  NRF_SAADC->TASKS_START = 0x1UL;
+
+  while (!NRF_SAADC->EVENTS_STARTED);
+  NRF_SAADC->EVENTS_STARTED = 0x0UL;
+
+  NRF_SAADC->RESULT.PTR = (uint32_t)buf1;
+
+  NRF_SAADC->INTENSET = SAADC_INTENSET_STARTED_Msk | SAADC_INTENSET_END_Msk;
+
+  NVIC_ClearPendingIRQ(SAADC_IRQn);
+  NVIC_SetPriority(SAADC_IRQn, 3);
+  NVIC_EnableIRQ(SAADC_IRQn);
+
+  NRF_PPI->CHENSET = (3UL << ppiCh);
+  timer->TASKS_START = 0x1UL;
+
+  return true;
+}
+
+void analogStreamStop( void )
+{
+  if (!streamTimer) {
+    return;
+  }
+
+  streamTimer->TASKS_STOP = 0x1UL;
+  NRF_PPI->CHENCLR = (3UL << streamPpiCh);
+
+  NVIC_DisableIRQ(SAADC_IRQn);
+  NRF_SAADC->INTENCLR = 0xFFFFFFFFUL;
+
+  NRF_SAADC->TASKS_STOP = 0x1UL;
+
+  while (!NRF_SAADC->EVENTS_STOPPED);
+  NRF_SAADC->EVENTS_STOPPED = 0x0UL;
+  NRF_SAADC->EVENTS_STARTED = 0x0UL;
+  NRF_SAADC->EVENTS_END = 0x0UL;
+
+  NRF_SAADC->ENABLE = (SAADC_ENABLE_ENABLE_Disabled << SAADC_ENABLE_ENABLE_Pos);
+
+  timerRelease(streamTimer);
+  streamTimer = NULL;
+}
+
+void SAADC_IRQHandler( void )
+{
+  // END first: the STARTED that follows it is for the other buffer
+  if (NRF_SAADC->EVENTS_END) {
+    NRF_SAADC->EVENTS_END = 0x0UL;
+
+    uint8_t done = streamFill;
+
+    streamFill ^= 1;
+
+    // every buffer is filled up; RESULT.AMOUNT may already be counting
+    // the next one, which END started in hardware
+    if (streamCallback) {
+      streamCallback(streamBufs[done], streamCount, streamArg);
+    }
+  }
+
+  if (NRF_SAADC->EVENTS_STARTED) {
+    NRF_SAADC->EVENTS_STARTED = 0x0UL;
+
+    NRF_SAADC->RESULT.PTR = (uint32_t)streamBufs[streamFill ^ 1];
+  }
+}
+
 // Right now, PWM output only works on the pins with
 // hardware support.  These are defined in the appropriate
 // pins_*.c file.  For the rest of the pins, we default
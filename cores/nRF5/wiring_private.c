@@ -18,3 +18,40 @@
 
 #include "Arduino.h"
 #include "wiring_private.h"
+
+#ifdef NRF52
+static bool timerReserved[2];
+
+static int timerIndex(NRF_TIMER_Type *timer)
+{
+  if (timer == NRF_TIMER3) {
+    return 0;
+  } else if (timer == NRF_TIMER4) {
+    return 1;
+  } else {
+    return -1;
+  }
+}
+
+int timerReserve(NRF_TIMER_Type *timer)
+{
+  int i = timerIndex(timer);
+
+  if (i < 0 || timerReserved[i]) {
+    return -1;
+  }
+
+  timerReserved[i] = true;
+
+  return TIMER_PPI_CH_BASE + 4 * i;
+}
+
+void timerRelease(NRF_TIMER_Type *timer)
+{
+  int i = timerIndex(timer);
+
+  if (i >= 0) {
+    timerReserved[i] = false;
+  }
+}
+#endif
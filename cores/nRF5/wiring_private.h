@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdarg.h>
@@ -29,6 +30,36 @@ extern "C" {
 
 #include "wiring_constants.h"
 
+// GPIOTE channels for core drivers, kept away from attachInterrupt().
+// gpioteReserve() returns -1 when all channels are in use.
+int gpioteReserve(void);
+void gpioteRelease(int ch);
+
+#ifdef NRF52
+#include "nrf.h"
+
+// Interrupts shared by SPIM/SPIS/TWIM/TWIS of one instance number. The
+// driver that enables the instance attaches its handler, which is called
+// with arg; attaching leaves the interrupt disabled in the NVIC. It fails
+// while another driver is attached, as the two would share registers.
+typedef void (*serialIrqHandler)(void *arg);
+
+bool serialIrqAttach(IRQn_Type irq, serialIrqHandler handler, void *arg);
+void serialIrqDetach(IRQn_Type irq, void *arg);
+
+// TIMER3 and TIMER4, the timers left over by the SoftDevice and Serial, each
+// come with four PPI channels from TIMER_PPI_CH_BASE: 2-5 for TIMER3 and
+// 6-9 for TIMER4. SoftUart, analogStreamStart() and the SPI stream timer
+// take one with timerReserve(), which returns the first of its channels,
+// or -1 for another timer or one already in use.
+#ifndef TIMER_PPI_CH_BASE
+#define TIMER_PPI_CH_BASE 2
+#endif
+
+int timerReserve(NRF_TIMER_Type *timer);
+void timerRelease(NRF_TIMER_Type *timer);
+#endif
+
 
 #ifdef __cplusplus
 } // extern "C"
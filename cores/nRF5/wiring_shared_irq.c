@@ -0,0 +1,118 @@
+/*
+  Copyright (c) 2015 Arduino LLC.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifdef NRF52
+
+#include "nrf.h"
+
+#include "wiring_private.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// SPIM, SPIS, TWIM and TWIS with the same instance number are one
+// peripheral underneath, with one interrupt. Libraries cannot each define
+// the handler, so the core does and calls the driver that attached.
+#define SERIAL_IRQ_COUNT 3
+
+static struct {
+  serialIrqHandler handler;
+  void *arg;
+} serialIrqs[SERIAL_IRQ_COUNT];
+
+static int serialIrqIndex(IRQn_Type irq)
+{
+  switch (irq) {
+    case SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn:
+      return 0;
+
+    case SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn:
+      return 1;
+
+    case SPIM2_SPIS2_SPI2_IRQn:
+      return 2;
+
+    default:
+      return -1;
+  }
+}
+
+bool serialIrqAttach(IRQn_Type irq, serialIrqHandler handler, void *arg)
+{
+  int i = serialIrqIndex(irq);
+
+  if (i < 0) {
+    return false;
+  }
+
+  // in use by another driver until it detaches
+  if (serialIrqs[i].arg && serialIrqs[i].arg != arg) {
+    return false;
+  }
+
+  NVIC_DisableIRQ(irq);
+
+  serialIrqs[i].handler = handler;
+  serialIrqs[i].arg = arg;
+
+  return true;
+}
+
+void serialIrqDetach(IRQn_Type irq, void *arg)
+{
+  int i = serialIrqIndex(irq);
+
+  // another driver may have taken the interrupt over since
+  if (i < 0 || serialIrqs[i].arg != arg) {
+    return;
+  }
+
+  NVIC_DisableIRQ(irq);
+
+  serialIrqs[i].handler = NULL;
+  serialIrqs[i].arg = NULL;
+}
+
+static void serialIrqDispatch(int i)
+{
+  if (serialIrqs[i].handler) {
+    serialIrqs[i].handler(serialIrqs[i].arg);
+  }
+}
+
+void SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQHandler(void)
+{
+  serialIrqDispatch(0);
+}
+
+void SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQHandler(void)
+{
+  serialIrqDispatch(1);
+}
+
+void SPIM2_SPIS2_SPI2_IRQHandler(void)
+{
+  serialIrqDispatch(2);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
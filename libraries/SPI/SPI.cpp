@@ -27,6 +27,24 @@
 #define SPI_IMODE_EXTINT 1
 #define SPI_IMODE_GLOBAL 2
 
+#ifdef NRF52
+static void spiIrq(void *arg)
+{
+  static_cast<SPIClass *>(arg)->onService();
+}
+
+// PPI resources for hardware chip select and array list streaming
+#define SPI_CS_PPI_CH        10   // STARTED -> CS low, END -> CS high (11)
+#define SPI_STREAM_PPI_CH    12   // END -> START and COUNT (in the group),
+                                  // END -> STOP (13, in the stop group),
+                                  // COMPARE[0] -> group off, stop group on (14)
+#define SPI_STREAM_PPI_GROUP 0
+#define SPI_STOP_PPI_GROUP   1
+
+static SPIClass *csOwner = NULL;
+static SPIClass *streamOwner = NULL;
+#endif
+
 const SPISettings DEFAULT_SPI_SETTINGS = SPISettings();
 
 SPIClass::SPIClass(NRF_SPI_Type *p_spi, uint8_t uc_pinMISO, uint8_t uc_pinSCK, uint8_t uc_pinMOSI)
@@ -40,28 +58,75 @@ SPIClass::SPIClass(NRF_SPI_Type *p_spi, uint8_t uc_pinMISO, uint8_t uc_pinSCK, u
   _uc_pinSCK = g_ADigitalPinMap[uc_pinSCK];
   _uc_pinMosi = g_ADigitalPinMap[uc_pinMOSI];
 
-  _dataMode = SPI_MODE0;
-  _bitOrder = SPI_CONFIG_ORDER_MsbFirst;
+#ifdef NRF52
+  _p_spim = (NRF_SPIM_Type *)p_spi;
+  _enable = SPI_ENABLE_ENABLE_Enabled;
+
+  if (p_spi == NRF_SPI0) {
+    _IRQn = SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn;
+  } else if (p_spi == NRF_SPI1) {
+    _IRQn = SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn;
+  } else {
+    _IRQn = SPIM2_SPIS2_SPI2_IRQn;
+  }
+
+  _asyncHead = 0;
+  _asyncTail = 0;
+  _asyncBusy = false;
+  _syncBusy = 0;
+  _asyncListChunks = 0;
+  _csGpiote = -1;
+  _csHeld = false;
+  _streamTimer = NULL;
+#endif
 }
 
-#ifdef ARDUINO_GENERIC
 void SPIClass::setPins(uint8_t uc_pinMISO, uint8_t uc_pinSCK, uint8_t uc_pinMOSI)
 {
   _uc_pinMiso = g_ADigitalPinMap[uc_pinMISO];
   _uc_pinSCK = g_ADigitalPinMap[uc_pinSCK];
   _uc_pinMosi = g_ADigitalPinMap[uc_pinMOSI];
 }
-#endif // ARDUINO_GENERIC
 
-void SPIClass::begin()
+bool SPIClass::begin()
 {
+#ifdef NRF52
+  if (!serialIrqAttach(_IRQn, spiIrq, this)) {
+    return false;
+  }
+#endif
+
   init();
 
+  // Pins are held by the GPIO whenever the peripheral lets go of them,
+  // e.g. while switching between SPI and SPIM. SCK idles as set by CPOL
+  // in config().
+  NRF_GPIO->OUTCLR = (1UL << _uc_pinSCK) | (1UL << _uc_pinMosi);
+  NRF_GPIO->PIN_CNF[_uc_pinSCK] = ((uint32_t)GPIO_PIN_CNF_DIR_Output << GPIO_PIN_CNF_DIR_Pos)
+                                | ((uint32_t)GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos);
+  NRF_GPIO->PIN_CNF[_uc_pinMosi] = ((uint32_t)GPIO_PIN_CNF_DIR_Output << GPIO_PIN_CNF_DIR_Pos)
+                                 | ((uint32_t)GPIO_PIN_CNF_INPUT_Disconnect << GPIO_PIN_CNF_INPUT_Pos);
+  NRF_GPIO->PIN_CNF[_uc_pinMiso] = ((uint32_t)GPIO_PIN_CNF_DIR_Input << GPIO_PIN_CNF_DIR_Pos)
+                                 | ((uint32_t)GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos);
+
   _p_spi->PSELSCK  = _uc_pinSCK;
   _p_spi->PSELMOSI = _uc_pinMosi;
   _p_spi->PSELMISO = _uc_pinMiso;
 
+#ifdef NRF52
+  // sent when a DMA transfer has no (more) TX data
+  _p_spim->ORC = 0xFF;
+#endif
+
   config(DEFAULT_SPI_SETTINGS);
+
+#ifdef NRF52
+  NVIC_ClearPendingIRQ(_IRQn);
+  NVIC_SetPriority(_IRQn, 3);
+  NVIC_EnableIRQ(_IRQn);
+#endif
+
+  return true;
 }
 
 void SPIClass::init()
@@ -76,41 +141,41 @@ void SPIClass::init()
 
 void SPIClass::config(SPISettings settings)
 {
-  _p_spi->ENABLE = (SPI_ENABLE_ENABLE_Disabled << SPI_ENABLE_ENABLE_Pos);
-
-  uint32_t config = settings.bitOrder;
+#ifdef NRF52
+  syncBegin();
+#endif
 
-  switch (settings.dataMode) {
-    default:
-    case SPI_MODE0:
-      config |= (SPI_CONFIG_CPOL_ActiveHigh << SPI_CONFIG_CPOL_Pos);
-      config |= (SPI_CONFIG_CPHA_Leading    << SPI_CONFIG_CPHA_Pos);
-      break;
+  _p_spi->ENABLE = (SPI_ENABLE_ENABLE_Disabled << SPI_ENABLE_ENABLE_Pos);
 
-    case SPI_MODE1:
-      config |= (SPI_CONFIG_CPOL_ActiveHigh << SPI_CONFIG_CPOL_Pos);
-      config |= (SPI_CONFIG_CPHA_Trailing   << SPI_CONFIG_CPHA_Pos);
-      break;
+  _settings = settings;
 
-    case SPI_MODE2:
-      config |= (SPI_CONFIG_CPOL_ActiveLow  << SPI_CONFIG_CPOL_Pos);
-      config |= (SPI_CONFIG_CPHA_Leading    << SPI_CONFIG_CPHA_Pos);
-      break;
+  _p_spi->CONFIG = _settings.config;
+  _p_spi->FREQUENCY = _settings.clockFreq;
 
-    case SPI_MODE3:
-      config |= (SPI_CONFIG_CPOL_ActiveLow  << SPI_CONFIG_CPOL_Pos);
-      config |= (SPI_CONFIG_CPHA_Trailing   << SPI_CONFIG_CPHA_Pos);
-      break;
+  if (_settings.config & SPI_CONFIG_CPOL_Msk) {
+    NRF_GPIO->OUTSET = (1UL << _uc_pinSCK);
+  } else {
+    NRF_GPIO->OUTCLR = (1UL << _uc_pinSCK);
   }
 
-  _p_spi->CONFIG = config;
-  _p_spi->FREQUENCY = settings.clockFreq;
+#ifdef NRF52
+  _p_spi->ENABLE = _enable;
 
+  syncEnd();
+#else
   _p_spi->ENABLE = (SPI_ENABLE_ENABLE_Enabled << SPI_ENABLE_ENABLE_Pos);
+#endif
 }
 
 void SPIClass::end()
 {
+#ifdef NRF52
+  // let queued transfers finish
+  while (_asyncHead != _asyncTail);
+
+  serialIrqDetach(_IRQn, this);
+#endif
+
   _p_spi->ENABLE = (SPI_ENABLE_ENABLE_Disabled << SPI_ENABLE_ENABLE_Pos);
 
   initialized = false;
@@ -122,6 +187,11 @@ void SPIClass::usingInterrupt(int /*interruptNumber*/)
 
 void SPIClass::beginTransaction(SPISettings settings)
 {
+  // back to back transactions with the same device leave the registers alone
+  if (settings == _settings) {
+    return;
+  }
+
   config(settings);
 }
 
@@ -131,66 +201,30 @@ void SPIClass::endTransaction(void)
 
 void SPIClass::setBitOrder(BitOrder order)
 {
-  this->_bitOrder = (order == MSBFIRST ? SPI_CONFIG_ORDER_MsbFirst : SPI_CONFIG_ORDER_LsbFirst);
-
-  uint32_t config = this->_bitOrder;
-
-  switch (this->_dataMode) {
-    default:
-    case SPI_MODE0:
-      config |= (SPI_CONFIG_CPOL_ActiveHigh << SPI_CONFIG_CPOL_Pos);
-      config |= (SPI_CONFIG_CPHA_Leading    << SPI_CONFIG_CPHA_Pos);
-      break;
-
-    case SPI_MODE1:
-      config |= (SPI_CONFIG_CPOL_ActiveHigh << SPI_CONFIG_CPOL_Pos);
-      config |= (SPI_CONFIG_CPHA_Trailing   << SPI_CONFIG_CPHA_Pos);
-      break;
-
-    case SPI_MODE2:
-      config |= (SPI_CONFIG_CPOL_ActiveLow  << SPI_CONFIG_CPOL_Pos);
-      config |= (SPI_CONFIG_CPHA_Leading    << SPI_CONFIG_CPHA_Pos);
-      break;
+#ifdef NRF52
+  syncBegin();
+#endif
 
-    case SPI_MODE3:
-      config |= (SPI_CONFIG_CPOL_ActiveLow  << SPI_CONFIG_CPOL_Pos);
-      config |= (SPI_CONFIG_CPHA_Trailing   << SPI_CONFIG_CPHA_Pos);
-      break;
-  }
+  _settings.config = (_settings.config & ~SPI_CONFIG_ORDER_Msk) | SPISettings::orderBits(order);
+  _p_spi->CONFIG = _settings.config;
 
-  _p_spi->CONFIG = config;
+#ifdef NRF52
+  syncEnd();
+#endif
 }
 
 void SPIClass::setDataMode(uint8_t mode)
 {
-  this->_dataMode = mode;
-
-  uint32_t config = this->_bitOrder;
-
-  switch (this->_dataMode) {
-    default:
-    case SPI_MODE0:
-      config |= (SPI_CONFIG_CPOL_ActiveHigh << SPI_CONFIG_CPOL_Pos);
-      config |= (SPI_CONFIG_CPHA_Leading    << SPI_CONFIG_CPHA_Pos);
-      break;
-
-    case SPI_MODE1:
-      config |= (SPI_CONFIG_CPOL_ActiveHigh << SPI_CONFIG_CPOL_Pos);
-      config |= (SPI_CONFIG_CPHA_Trailing   << SPI_CONFIG_CPHA_Pos);
-      break;
-
-    case SPI_MODE2:
-      config |= (SPI_CONFIG_CPOL_ActiveLow  << SPI_CONFIG_CPOL_Pos);
-      config |= (SPI_CONFIG_CPHA_Leading    << SPI_CONFIG_CPHA_Pos);
-      break;
+#ifdef NRF52
+  syncBegin();
+#endif
 
-    case SPI_MODE3:
-      config |= (SPI_CONFIG_CPOL_ActiveLow  << SPI_CONFIG_CPOL_Pos);
-      config |= (SPI_CONFIG_CPHA_Trailing   << SPI_CONFIG_CPHA_Pos);
-      break;
-  }
+  _settings.config = (_settings.config & SPI_CONFIG_ORDER_Msk) | SPISettings::modeBits(mode);
+  _p_spi->CONFIG = _settings.config;
 
-  _p_spi->CONFIG = config;
+#ifdef NRF52
+  syncEnd();
+#endif
 }
 
 void SPIClass::setClockDivider(uint8_t div)
@@ -213,11 +247,30 @@ void SPIClass::setClockDivider(uint8_t div)
     clockFreq = SPI_FREQUENCY_FREQUENCY_M8;
   }
 
+#ifdef NRF52
+  syncBegin();
+#endif
+
+  _settings.clockFreq = clockFreq;
   _p_spi->FREQUENCY = clockFreq;
+
+#ifdef NRF52
+  syncEnd();
+#endif
 }
 
 byte SPIClass::transfer(uint8_t data)
 {
+#ifdef NRF52
+  syncBegin();
+  enableSpi();
+
+  // the SPI half raises no STARTED/END events
+  if (_csGpiote >= 0) {
+    NRF_GPIOTE->TASKS_CLR[_csGpiote] = 0x1UL;
+  }
+#endif
+
   _p_spi->TXD = data;
 
   while(!_p_spi->EVENTS_READY);
@@ -226,25 +279,629 @@ byte SPIClass::transfer(uint8_t data)
 
   _p_spi->EVENTS_READY = 0x0UL;
 
+#ifdef NRF52
+  csEnd();
+  syncEnd();
+#endif
+
   return data;
 }
 
 uint16_t SPIClass::transfer16(uint16_t data) {
   union { uint16_t val; struct { uint8_t lsb; uint8_t msb; }; } t;
+  bool lsbFirst = (_settings.config & SPI_CONFIG_ORDER_Msk) == (SPI_CONFIG_ORDER_LsbFirst << SPI_CONFIG_ORDER_Pos);
 
   t.val = data;
 
-  if (_bitOrder == SPI_CONFIG_ORDER_LsbFirst) {
-    t.lsb = transfer(t.lsb);
-    t.msb = transfer(t.msb);
+  // as one block, so both bytes share a chip select frame
+  uint8_t buf[2] = { lsbFirst ? t.lsb : t.msb, lsbFirst ? t.msb : t.lsb };
+
+  transfer(buf, buf, 2);
+
+  t.lsb = buf[lsbFirst ? 0 : 1];
+  t.msb = buf[lsbFirst ? 1 : 0];
+
+  return t.val;
+}
+
+void SPIClass::transfer(void *buf, size_t count)
+{
+  transfer(buf, buf, count);
+}
+
+void SPIClass::transfer(const void *txBuf, void *rxBuf, size_t count)
+{
+  const uint8_t *tx = reinterpret_cast<const uint8_t *>(txBuf);
+  uint8_t *rx = reinterpret_cast<uint8_t *>(rxBuf);
+
+#ifdef NRF52
+  // a lone byte goes through SPI: SPIM clocks out an extra byte when both
+  // MAXCNTs are at most 1 (nRF52832 anomaly 58)
+  if (count > 1) {
+    syncBegin();
+    dmaTransfer(tx, rx, count);
+    syncEnd();
+    return;
+  }
+#endif
+
+  for (size_t i = 0; i < count; i++) {
+    uint8_t data = transfer(tx ? tx[i] : 0xFF);
+
+    if (rx) {
+      rx[i] = data;
+    }
+  }
+}
+
+void SPIClass::transfer(const SPISegment *segments, size_t segmentCount)
+{
+#ifdef NRF52
+  syncBegin();
+
+  if (_csGpiote >= 0) {
+    _csHeld = true;
+    csBegin(true);
+    NRF_GPIOTE->TASKS_CLR[_csGpiote] = 0x1UL;
+  }
+#endif
+
+  for (size_t i = 0; i < segmentCount; i++) {
+    transfer(segments[i].tx, segments[i].rx, segments[i].count);
+  }
+
+#ifdef NRF52
+  _csHeld = false;
+  csEnd();
+  syncEnd();
+#endif
+}
+
+bool SPIClass::transferAsync(const void *txBuf, void *rxBuf, size_t count, SPICallback callback, void *arg)
+{
+  SPISegment segment = { txBuf, rxBuf, count };
+
+  return asyncPush(segment, NULL, 0, _settings.config, _settings.clockFreq, -1, callback, arg);
+}
+
+bool SPIClass::transferAsync(SPISettings settings, int csPin, const void *txBuf, void *rxBuf, size_t count, SPICallback callback, void *arg)
+{
+  SPISegment segment = { txBuf, rxBuf, count };
+
+  return asyncPush(segment, NULL, 0, settings.config, settings.clockFreq, csPin, callback, arg);
+}
+
+bool SPIClass::transferAsync(SPISettings settings, int csPin, const SPISegment *segments, size_t segmentCount, SPICallback callback, void *arg)
+{
+  if (segmentCount == 0) {
+    SPISegment empty = { NULL, NULL, 0 };
+
+    return asyncPush(empty, NULL, 0, settings.config, settings.clockFreq, csPin, callback, arg);
+  }
+
+  return asyncPush(segments[0], segments + 1, segmentCount - 1, settings.config, settings.clockFreq, csPin, callback, arg);
+}
+
+bool SPIClass::streamAsync(const void *txBuf, size_t count, SPICallback callback, void *arg)
+{
+  return transferAsync(txBuf, NULL, count, callback, arg);
+}
+
+bool SPIClass::asyncPush(const SPISegment &first, const SPISegment *rest, size_t restCount, uint32_t config, uint32_t frequency, int csPin, SPICallback callback, void *arg)
+{
+  uint8_t cs = (csPin < 0) ? 0xFF : g_ADigitalPinMap[csPin];
+  const SPISegment *segment = &first;
+
+  // empty segments are skipped; a transfer with nothing left is still
+  // queued, so that its callback keeps its place in line
+  while (segment->count == 0 && restCount) {
+    segment = rest++;
+    restCount--;
+  }
+
+  // the chip select idles high
+  if (cs != 0xFF && !(NRF_GPIO->DIR & (1UL << cs))) {
+    NRF_GPIO->OUTSET = (1UL << cs);
+    NRF_GPIO->DIRSET = (1UL << cs);
+  }
+
+#ifdef NRF52
+  if (segment->count == 1 && segment->rx) {
+    return false;
+  }
+
+  for (size_t i = 0; i < restCount; i++) {
+    if (rest[i].count == 1 && rest[i].rx) {
+      return false;
+    }
+  }
+
+  NVIC_DisableIRQ(_IRQn);
+
+  if ((uint8_t)(_asyncTail - _asyncHead) == SPI_ASYNC_QUEUE_SIZE) {
+    NVIC_EnableIRQ(_IRQn);
+    return false;
+  }
+
+  AsyncTransfer &t = _asyncQueue[_asyncTail & (SPI_ASYNC_QUEUE_SIZE - 1)];
+
+  t.tx = reinterpret_cast<const uint8_t *>(segment->tx);
+  t.rx = reinterpret_cast<uint8_t *>(segment->rx);
+  t.count = segment->count;
+  t.next = rest;
+  t.nextCount = restCount;
+  t.config = config;
+  t.frequency = frequency;
+  t.csPin = cs;
+  t.callback = callback;
+  t.arg = arg;
+
+  _asyncTail++;
+
+  if (!_asyncBusy && !_syncBusy) {
+    asyncNext();
+  }
+
+  NVIC_EnableIRQ(_IRQn);
+#else
+  // no EasyDMA on nRF51: run it now
+  _p_spi->CONFIG = config;
+  _p_spi->FREQUENCY = frequency;
+
+  if (segment->count == 0) {
+    cs = 0xFF;
+  }
+
+  if (cs != 0xFF) {
+    NRF_GPIO->OUTCLR = (1UL << cs);
+  }
+
+  transfer(segment->tx, segment->rx, segment->count);
+
+  for (size_t i = 0; i < restCount; i++) {
+    transfer(rest[i].tx, rest[i].rx, rest[i].count);
+  }
+
+  if (cs != 0xFF) {
+    NRF_GPIO->OUTSET = (1UL << cs);
+  }
+
+  _p_spi->CONFIG = _settings.config;
+  _p_spi->FREQUENCY = _settings.clockFreq;
+
+  if (callback) {
+    callback(arg);
+  }
+#endif
+
+  return true;
+}
+
+#ifdef NRF52
+void SPIClass::enableSpi()
+{
+  if (_enable != SPI_ENABLE_ENABLE_Enabled) {
+    _enable = SPI_ENABLE_ENABLE_Enabled;
+
+    _p_spi->ENABLE = (SPI_ENABLE_ENABLE_Disabled << SPI_ENABLE_ENABLE_Pos);
+    _p_spi->ENABLE = _enable;
+  }
+}
+
+void SPIClass::enableSpim()
+{
+  if (_enable != SPIM_ENABLE_ENABLE_Enabled) {
+    _enable = SPIM_ENABLE_ENABLE_Enabled;
+
+    _p_spi->ENABLE = (SPI_ENABLE_ENABLE_Disabled << SPI_ENABLE_ENABLE_Pos);
+    _p_spim->ENABLE = _enable;
+  }
+}
+
+// Runs a block through EasyDMA, SPI_DMA_MAXCNT bytes at a time. Within a
+// chunk the bytes go out back to back at the full clock rate. TX and RX may
+// be the same buffer.
+void SPIClass::dmaTransfer(const uint8_t *tx, uint8_t *rx, size_t count)
+{
+  // EasyDMA can only read RAM, so TX data in flash goes through the stack
+  uint8_t bounce[64];
+  bool inFlash = tx && ((uint32_t)tx < 0x20000000);
+
+  enableSpim();
+  csBegin(count > (inFlash ? sizeof(bounce) : SPI_DMA_MAXCNT));
+
+  while (count) {
+    size_t n = (count < SPI_DMA_MAXCNT) ? count : SPI_DMA_MAXCNT;
+
+    if (inFlash && n > sizeof(bounce)) {
+      n = sizeof(bounce);
+    }
+
+    // never leave a single byte for the last chunk (anomaly 58)
+    if (count - n == 1) {
+      n--;
+    }
+
+    const uint8_t *txChunk = tx;
+
+    if (inFlash) {
+      memcpy(bounce, tx, n);
+      txChunk = bounce;
+    }
+
+    _p_spim->TXD.PTR = (uint32_t)txChunk;
+    _p_spim->TXD.MAXCNT = tx ? n : 0;
+    _p_spim->RXD.PTR = (uint32_t)rx;
+    _p_spim->RXD.MAXCNT = rx ? n : 0;
+
+    _p_spim->EVENTS_END = 0x0UL;
+    _p_spim->TASKS_START = 0x1UL;
+
+    while (!_p_spim->EVENTS_END);
+
+    _p_spim->EVENTS_END = 0x0UL;
+
+    if (tx) {
+      tx += n;
+    }
+    if (rx) {
+      rx += n;
+    }
+    count -= n;
+  }
+
+  csEnd();
+}
+
+// Claims the bus for a synchronous call, after the transfer in flight.
+// Queued transfers that are not started yet wait for the outermost
+// syncEnd().
+void SPIClass::syncBegin()
+{
+  _syncBusy++;
+
+  while (_asyncBusy) {
+    // called with the SPI interrupt masked: finish the transfer here
+    uint32_t ipsr = __get_IPSR();
+
+    if (__get_PRIMASK() || (ipsr && NVIC_GetPriority((IRQn_Type)((int)ipsr - 16)) <= NVIC_GetPriority(_IRQn))) {
+      // checks for itself whether the transfer is done
+      onService();
+    }
+  }
+}
+
+void SPIClass::syncEnd()
+{
+  _syncBusy--;
+
+  // start anything queued in the meantime
+  if (!_syncBusy && _asyncHead != _asyncTail) {
+    NVIC_SetPendingIRQ(_IRQn);
+  }
+}
+
+// Starts the transfer at the head of the queue. Called with the SPI
+// interrupt masked (or from it) while the bus is free.
+void SPIClass::asyncNext()
+{
+  if (_asyncHead == _asyncTail) {
+    return;
+  }
+
+  AsyncTransfer &t = _asyncQueue[_asyncHead & (SPI_ASYNC_QUEUE_SIZE - 1)];
+
+  // nothing to clock out: the interrupt completes it in its turn
+  if (t.count == 0) {
+    _asyncBusy = true;
+    NVIC_SetPendingIRQ(_IRQn);
+    return;
+  }
+
+  enableSpim();
+
+  _p_spi->CONFIG = t.config;
+  _p_spi->FREQUENCY = t.frequency;
+
+  if (t.csPin != 0xFF) {
+    // the entry brings its own CS, so the hardware one stays high
+    if (_csGpiote >= 0) {
+      NRF_PPI->CHENCLR = (3UL << SPI_CS_PPI_CH);
+    }
+
+    NRF_GPIO->OUTCLR = (1UL << t.csPin);
   } else {
-    t.msb = transfer(t.msb);
-    t.lsb = transfer(t.lsb);
+    csBegin(t.nextCount || t.count > ((t.tx && (uint32_t)t.tx < 0x20000000) ? sizeof(_asyncBounce) : SPI_DMA_MAXCNT));
   }
 
-  return t.val;
+  _asyncBusy = true;
+  _p_spim->INTENSET = SPIM_INTENSET_END_Msk;
+
+  asyncChunk();
+}
+
+// Starts the next chunk of the head transfer, split as in dmaTransfer()
+void SPIClass::asyncChunk()
+{
+  AsyncTransfer &t = _asyncQueue[_asyncHead & (SPI_ASYNC_QUEUE_SIZE - 1)];
+  size_t n = (t.count < SPI_DMA_MAXCNT) ? t.count : SPI_DMA_MAXCNT;
+  bool inFlash = t.tx && ((uint32_t)t.tx < 0x20000000);
+
+  // long sends from RAM run as an array list, chained by the stream timer:
+  // END restarts SPIM with TXD.PTR moved on by MAXCNT, until the timer has
+  // counted all but the last chunk and switches the chain off. The END of
+  // the last chunk then stops SPIM, and only STOPPED interrupts.
+  if (_streamTimer && !t.rx && !inFlash && t.count >= 2 * SPI_DMA_MAXCNT) {
+    _asyncListChunks = t.count / SPI_DMA_MAXCNT;
+
+    _streamTimer->TASKS_CLEAR = 0x1UL;
+    _streamTimer->CC[0] = _asyncListChunks - 1;
+    NRF_PPI->TASKS_CHG[SPI_STREAM_PPI_GROUP].EN = 0x1UL;
+
+    _p_spim->INTENCLR = SPIM_INTENCLR_END_Msk;
+    _p_spim->EVENTS_STOPPED = 0x0UL;
+    _p_spim->INTENSET = SPIM_INTENSET_STOPPED_Msk;
+
+    _p_spim->TXD.LIST = (SPIM_TXD_LIST_LIST_ArrayList << SPIM_TXD_LIST_LIST_Pos);
+    _p_spim->TXD.PTR = (uint32_t)t.tx;
+    _p_spim->TXD.MAXCNT = SPI_DMA_MAXCNT;
+    _p_spim->RXD.MAXCNT = 0;
+
+    _p_spim->EVENTS_END = 0x0UL;
+    _p_spim->TASKS_START = 0x1UL;
+    return;
+  }
+
+  if (inFlash && n > sizeof(_asyncBounce)) {
+    n = sizeof(_asyncBounce);
+  }
+
+  if (t.count - n == 1) {
+    n--;
+  }
+
+  const uint8_t *txChunk = t.tx;
+
+  if (inFlash) {
+    memcpy(_asyncBounce, t.tx, n);
+    txChunk = _asyncBounce;
+  }
+
+  _asyncChunkLen = n;
+
+  _p_spim->TXD.PTR = (uint32_t)txChunk;
+  _p_spim->TXD.MAXCNT = t.tx ? n : 0;
+  _p_spim->RXD.PTR = (uint32_t)t.rx;
+  _p_spim->RXD.MAXCNT = t.rx ? n : 0;
+
+  _p_spim->EVENTS_END = 0x0UL;
+  _p_spim->TASKS_START = 0x1UL;
 }
 
+void SPIClass::onService(void)
+{
+  AsyncTransfer &t = _asyncQueue[_asyncHead & (SPI_ASYNC_QUEUE_SIZE - 1)];
+
+  // an empty transfer never started SPIM; for any other, count only
+  // drops to 0 in here
+  bool empty = (t.count == 0);
+
+  if (_asyncBusy && (empty || (_asyncListChunks ? _p_spim->EVENTS_STOPPED : _p_spim->EVENTS_END))) {
+    size_t done = empty ? 0 : _asyncChunkLen;
+
+    // a list has raised END for every chunk by the time it stops
+    if (!empty) {
+      _p_spim->EVENTS_END = 0x0UL;
+    }
+
+    if (_asyncListChunks) {
+      _p_spim->EVENTS_STOPPED = 0x0UL;
+      NRF_PPI->TASKS_CHG[SPI_STOP_PPI_GROUP].DIS = 0x1UL;
+
+      _p_spim->INTENCLR = SPIM_INTENCLR_STOPPED_Msk;
+      _p_spim->INTENSET = SPIM_INTENSET_END_Msk;
+
+      _p_spim->TXD.LIST = (SPIM_TXD_LIST_LIST_Disabled << SPIM_TXD_LIST_LIST_Pos);
+      done = (size_t)_asyncListChunks * SPI_DMA_MAXCNT;
+      _asyncListChunks = 0;
+    }
+
+    if (t.tx) {
+      t.tx += done;
+    }
+    if (t.rx) {
+      t.rx += done;
+    }
+    t.count -= done;
+
+    // on to the next segment, still under the same CS
+    while (t.count == 0 && t.nextCount) {
+      t.tx = reinterpret_cast<const uint8_t *>(t.next->tx);
+      t.rx = reinterpret_cast<uint8_t *>(t.next->rx);
+      t.count = t.next->count;
+      t.next++;
+      t.nextCount--;
+    }
+
+    if (t.count) {
+      asyncChunk();
+      return;
+    }
+
+    // an empty transfer drove no CS
+    if (!empty) {
+      if (t.csPin != 0xFF) {
+        NRF_GPIO->OUTSET = (1UL << t.csPin);
+      } else {
+        csEnd();
+      }
+    }
+
+    SPICallback callback = t.callback;
+    void *arg = t.arg;
+
+    // free the entry before the callback, which may queue the next transfer
+    _p_spim->INTENCLR = SPIM_INTENCLR_END_Msk;
+    _asyncHead++;
+    _asyncBusy = false;
+
+    if (callback) {
+      callback(arg);
+    }
+  }
+
+  if (!_asyncBusy) {
+    if (!_syncBusy && _asyncHead != _asyncTail) {
+      asyncNext();
+    } else {
+      // hand the bus back with the synchronous settings
+      _p_spi->CONFIG = _settings.config;
+      _p_spi->FREQUENCY = _settings.clockFreq;
+    }
+  }
+}
+
+// The CS channels are only on for the duration of a hardware CS transfer,
+// so that async transfers with their own CS pin leave it alone. Framing by
+// PPI only works for a single chunk: between chunks END would raise CS, so
+// for longer blocks it is left to csEnd().
+void SPIClass::csBegin(bool multiChunk)
+{
+  if (_csGpiote < 0) {
+    return;
+  }
+
+  if (_csHeld) {
+    NRF_PPI->CHENCLR = (3UL << SPI_CS_PPI_CH);
+  } else if (multiChunk) {
+    NRF_PPI->CHENCLR = (1UL << (SPI_CS_PPI_CH + 1));
+    NRF_PPI->CHENSET = (1UL << SPI_CS_PPI_CH);
+  } else {
+    NRF_PPI->CHENSET = (3UL << SPI_CS_PPI_CH);
+  }
+}
+
+void SPIClass::csEnd()
+{
+  if (_csGpiote < 0) {
+    return;
+  }
+
+  NRF_PPI->CHENCLR = (3UL << SPI_CS_PPI_CH);
+
+  if (!_csHeld) {
+    NRF_GPIOTE->TASKS_SET[_csGpiote] = 0x1UL;
+  }
+}
+
+bool SPIClass::setHardwareCS(int csPin)
+{
+  bool ok = true;
+
+  syncBegin();
+
+  if (_csGpiote >= 0) {
+    NRF_PPI->CHENCLR = (3UL << SPI_CS_PPI_CH);
+
+    // the GPIO holds CS high once GPIOTE lets go of it
+    gpioteRelease(_csGpiote);
+    _csGpiote = -1;
+    csOwner = NULL;
+  }
+
+  if (csPin >= 0) {
+    int ch = (csOwner == NULL) ? gpioteReserve() : -1;
+
+    if (ch < 0) {
+      ok = false;
+    } else {
+      uint32_t pin = g_ADigitalPinMap[csPin];
+
+      NRF_GPIO->OUTSET = (1UL << pin);
+      NRF_GPIO->DIRSET = (1UL << pin);
+
+      NRF_GPIOTE->CONFIG[ch] = (GPIOTE_CONFIG_MODE_Task << GPIOTE_CONFIG_MODE_Pos)
+                             | (pin << GPIOTE_CONFIG_PSEL_Pos)
+                             | (GPIOTE_CONFIG_POLARITY_Toggle << GPIOTE_CONFIG_POLARITY_Pos)
+                             | (GPIOTE_CONFIG_OUTINIT_High << GPIOTE_CONFIG_OUTINIT_Pos);
+
+      NRF_PPI->CH[SPI_CS_PPI_CH].EEP = (uint32_t)&_p_spim->EVENTS_STARTED;
+      NRF_PPI->CH[SPI_CS_PPI_CH].TEP = (uint32_t)&NRF_GPIOTE->TASKS_CLR[ch];
+      NRF_PPI->CH[SPI_CS_PPI_CH + 1].EEP = (uint32_t)&_p_spim->EVENTS_END;
+      NRF_PPI->CH[SPI_CS_PPI_CH + 1].TEP = (uint32_t)&NRF_GPIOTE->TASKS_SET[ch];
+
+      _csGpiote = ch;
+      csOwner = this;
+    }
+  }
+
+  syncEnd();
+
+  return ok;
+}
+
+bool SPIClass::setStreamTimer(NRF_TIMER_Type *timer)
+{
+  bool ok = true;
+
+  // a running list needs its timer until the end
+  syncBegin();
+
+  if (_streamTimer) {
+    NRF_PPI->CHENCLR = (7UL << SPI_STREAM_PPI_CH);
+    NRF_PPI->CHG[SPI_STREAM_PPI_GROUP] = 0;
+    NRF_PPI->CHG[SPI_STOP_PPI_GROUP] = 0;
+
+    _streamTimer->TASKS_STOP = 0x1UL;
+    timerRelease(_streamTimer);
+    _streamTimer = NULL;
+    streamOwner = NULL;
+  }
+
+  if (timer) {
+    // SoftUart and analog streams take the same timers
+    if (streamOwner || timerReserve(timer) < 0) {
+      ok = false;
+    } else {
+      timer->TASKS_STOP = 0x1UL;
+      timer->INTENCLR = 0xFFFFFFFF;
+      timer->SHORTS = 0;
+      timer->MODE = TIMER_MODE_MODE_Counter;
+      timer->BITMODE = TIMER_BITMODE_BITMODE_16Bit;
+      timer->TASKS_CLEAR = 0x1UL;
+      timer->TASKS_START = 0x1UL;
+
+      NRF_PPI->CH[SPI_STREAM_PPI_CH].EEP = (uint32_t)&_p_spim->EVENTS_END;
+      NRF_PPI->CH[SPI_STREAM_PPI_CH].TEP = (uint32_t)&_p_spim->TASKS_START;
+      NRF_PPI->FORK[SPI_STREAM_PPI_CH].TEP = (uint32_t)&timer->TASKS_COUNT;
+      NRF_PPI->CH[SPI_STREAM_PPI_CH + 1].EEP = (uint32_t)&_p_spim->EVENTS_END;
+      NRF_PPI->CH[SPI_STREAM_PPI_CH + 1].TEP = (uint32_t)&_p_spim->TASKS_STOP;
+      NRF_PPI->CH[SPI_STREAM_PPI_CH + 2].EEP = (uint32_t)&timer->EVENTS_COMPARE[0];
+      NRF_PPI->CH[SPI_STREAM_PPI_CH + 2].TEP = (uint32_t)&NRF_PPI->TASKS_CHG[SPI_STREAM_PPI_GROUP].DIS;
+      NRF_PPI->FORK[SPI_STREAM_PPI_CH + 2].TEP = (uint32_t)&NRF_PPI->TASKS_CHG[SPI_STOP_PPI_GROUP].EN;
+
+      // the restart and stop channels are only switched on, through their
+      // groups, for a list
+      NRF_PPI->CHG[SPI_STREAM_PPI_GROUP] = (1UL << SPI_STREAM_PPI_CH);
+      NRF_PPI->CHG[SPI_STOP_PPI_GROUP] = (1UL << (SPI_STREAM_PPI_CH + 1));
+      NRF_PPI->CHENCLR = (3UL << SPI_STREAM_PPI_CH);
+      NRF_PPI->CHENSET = (1UL << (SPI_STREAM_PPI_CH + 2));
+
+      _streamTimer = timer;
+      streamOwner = this;
+    }
+  }
+
+  syncEnd();
+
+  return ok;
+}
+#else
+void SPIClass::onService(void)
+{
+}
+#endif
+
 void SPIClass::attachInterrupt() {
   // Should be enableInterrupt()
 }
@@ -253,9 +910,31 @@ void SPIClass::detachInterrupt() {
   // Should be disableInterrupt()
 }
 
+// Extra ports the variant gives no pins start on SPI's, and are moved with
+// setPins() before begin()
+#if SPI_INTERFACES_COUNT > 1 && !defined(PIN_SPI1_MISO)
+#define PIN_SPI1_MISO PIN_SPI_MISO
+#define PIN_SPI1_SCK  PIN_SPI_SCK
+#define PIN_SPI1_MOSI PIN_SPI_MOSI
+#endif
+#if SPI_INTERFACES_COUNT > 2 && !defined(PIN_SPI2_MISO)
+#define PIN_SPI2_MISO PIN_SPI_MISO
+#define PIN_SPI2_SCK  PIN_SPI_SCK
+#define PIN_SPI2_MOSI PIN_SPI_MOSI
+#endif
+
+// On nRF52 SPI1 is SPIM2, the only instance not shared with a TWI, and
+// SPI2 is SPIM1, which cannot run while Wire (TWIM1) is in use
 #if SPI_INTERFACES_COUNT > 0
 SPIClass SPI (NRF_SPI0,  PIN_SPI_MISO,  PIN_SPI_SCK,  PIN_SPI_MOSI);
 #endif
 #if SPI_INTERFACES_COUNT > 1
+#ifdef NRF52
+SPIClass SPI1(NRF_SPI2, PIN_SPI1_MISO, PIN_SPI1_SCK, PIN_SPI1_MOSI);
+#else
 SPIClass SPI1(NRF_SPI1, PIN_SPI1_MISO, PIN_SPI1_SCK, PIN_SPI1_MOSI);
 #endif
+#endif
+#if SPI_INTERFACES_COUNT > 2
+SPIClass SPI2(NRF_SPI1, PIN_SPI2_MISO, PIN_SPI2_SCK, PIN_SPI2_MOSI);
+#endif
@@ -35,51 +35,68 @@
 #define SPI_MODE2 0x03
 #define SPI_MODE3 0x01
 
+#ifdef NRF52
+// Largest block moved by one SPIM EasyDMA transaction (MAXCNT is 8 bits)
+#define SPI_DMA_MAXCNT 255
+#endif
+
+// Number of transferAsync() calls that can be pending, a power of two
+#ifndef SPI_ASYNC_QUEUE_SIZE
+#define SPI_ASYNC_QUEUE_SIZE 8
+#endif
 
+typedef void (*SPICallback)(void *arg);
+
+// One part of a multi-part exchange, with the same meaning as the
+// arguments of transfer(txBuf, rxBuf, count)
+struct SPISegment {
+  const void *tx;
+  void *rx;
+  size_t count;
+};
+
+
+// Holds the CONFIG and FREQUENCY register values for a device, worked out
+// once when the settings are constructed (at compile time for constant
+// arguments), so beginTransaction() only has to compare and copy them.
 class SPISettings {
   public:
-  SPISettings(uint32_t clock, BitOrder bitOrder, uint8_t dataMode) {
-    if (__builtin_constant_p(clock)) {
-      init_AlwaysInline(clock, bitOrder, dataMode);
-    } else {
-      init_MightInline(clock, bitOrder, dataMode);
-    }
-  }
+  constexpr SPISettings(uint32_t clock, BitOrder bitOrder, uint8_t dataMode)
+    : clockFreq(frequencyFor(clock)), config(orderBits(bitOrder) | modeBits(dataMode)) { }
 
   // Default speed set to 4MHz, SPI mode set to MODE 0 and Bit order set to MSB first.
-  SPISettings() { init_AlwaysInline(4000000, MSBFIRST, SPI_MODE0); }
+  constexpr SPISettings() : SPISettings(4000000, MSBFIRST, SPI_MODE0) { }
+
+  bool operator==(const SPISettings &rhs) const { return config == rhs.config && clockFreq == rhs.clockFreq; }
 
   private:
-  void init_MightInline(uint32_t clock, BitOrder bitOrder, uint8_t dataMode) {
-    init_AlwaysInline(clock, bitOrder, dataMode);
+  static constexpr uint32_t frequencyFor(uint32_t clock) {
+    return (clock <= 125000)  ? SPI_FREQUENCY_FREQUENCY_K125 :
+           (clock <= 250000)  ? SPI_FREQUENCY_FREQUENCY_K250 :
+           (clock <= 500000)  ? SPI_FREQUENCY_FREQUENCY_K500 :
+           (clock <= 1000000) ? SPI_FREQUENCY_FREQUENCY_M1 :
+           (clock <= 2000000) ? SPI_FREQUENCY_FREQUENCY_M2 :
+           (clock <= 4000000) ? SPI_FREQUENCY_FREQUENCY_M4 :
+                                SPI_FREQUENCY_FREQUENCY_M8;
   }
 
-  void init_AlwaysInline(uint32_t clock, BitOrder bitOrder, uint8_t dataMode) __attribute__((__always_inline__)) {
-    if (clock <= 125000) {
-      this->clockFreq = SPI_FREQUENCY_FREQUENCY_K125;
-    } else if (clock <= 250000) {
-      this->clockFreq = SPI_FREQUENCY_FREQUENCY_K250;
-    } else if (clock <= 500000) {
-      this->clockFreq = SPI_FREQUENCY_FREQUENCY_K500;
-    } else if (clock <= 1000000) {
-      this->clockFreq = SPI_FREQUENCY_FREQUENCY_M1;
-    } else if (clock <= 2000000) {
-      this->clockFreq = SPI_FREQUENCY_FREQUENCY_M2;
-    } else if (clock <= 4000000) {
-      this->clockFreq = SPI_FREQUENCY_FREQUENCY_M4;
-    } else {
-      this->clockFreq = SPI_FREQUENCY_FREQUENCY_M8;
-    }
-
-    this->bitOrder = (bitOrder == MSBFIRST ? SPI_CONFIG_ORDER_MsbFirst : SPI_CONFIG_ORDER_LsbFirst);
-    this->dataMode = dataMode;
+  static constexpr uint32_t orderBits(BitOrder bitOrder) {
+    return (bitOrder == MSBFIRST ? SPI_CONFIG_ORDER_MsbFirst : SPI_CONFIG_ORDER_LsbFirst) << SPI_CONFIG_ORDER_Pos;
   }
 
-  uint32_t clockFreq;
-  uint8_t dataMode;
-  uint32_t bitOrder;
+  // CPOL and CPHA for an SPI mode, unknown modes are taken as mode 0
+  static constexpr uint32_t modeBits(uint8_t dataMode) {
+    return (dataMode == SPI_MODE1) ? ((SPI_CONFIG_CPOL_ActiveHigh << SPI_CONFIG_CPOL_Pos) | (SPI_CONFIG_CPHA_Trailing << SPI_CONFIG_CPHA_Pos)) :
+           (dataMode == SPI_MODE2) ? ((SPI_CONFIG_CPOL_ActiveLow  << SPI_CONFIG_CPOL_Pos) | (SPI_CONFIG_CPHA_Leading  << SPI_CONFIG_CPHA_Pos)) :
+           (dataMode == SPI_MODE3) ? ((SPI_CONFIG_CPOL_ActiveLow  << SPI_CONFIG_CPOL_Pos) | (SPI_CONFIG_CPHA_Trailing << SPI_CONFIG_CPHA_Pos)) :
+                                     ((SPI_CONFIG_CPOL_ActiveHigh << SPI_CONFIG_CPOL_Pos) | (SPI_CONFIG_CPHA_Leading  << SPI_CONFIG_CPHA_Pos));
+  }
+
+  uint32_t clockFreq;             // FREQUENCY register
+  uint32_t config;                // CONFIG register
 
   friend class SPIClass;
+  friend class SPISlave;
 };
 
 class SPIClass {
@@ -89,7 +106,50 @@ class SPIClass {
 
   byte transfer(uint8_t data);
   uint16_t transfer16(uint16_t data);
-  inline void transfer(void *buf, size_t count);
+  void transfer(void *buf, size_t count);
+  // Sends count bytes from txBuf while receiving into rxBuf. Either may be
+  // NULL: 0xFF is sent when there is no txBuf, and received data is
+  // dropped when there is no rxBuf.
+  void transfer(const void *txBuf, void *rxBuf, size_t count);
+  // Runs the segments back to back. With hardware CS they share one chip
+  // select frame; otherwise frame them with the CS pin as usual.
+  void transfer(const SPISegment *segments, size_t segmentCount);
+
+  // Queues a transfer and returns straight away; callback(arg) is called
+  // from the SPI interrupt once it is done. Transfers run back to back in
+  // the order queued, each with its own settings and chip select (driven
+  // low for the transfer, or -1 for none). The buffers must stay valid
+  // until the callback. Returns false if the queue is full, or for a
+  // single byte read, which SPIM cannot do (use transfer() instead).
+  // Synchronous calls wait for queued transfers to finish first.
+  bool transferAsync(const void *txBuf, void *rxBuf, size_t count, SPICallback callback, void *arg = NULL);
+  bool transferAsync(SPISettings settings, int csPin, const void *txBuf, void *rxBuf, size_t count, SPICallback callback, void *arg = NULL);
+  // Queues a multi-part exchange (e.g. command, status, data block) under
+  // one chip select, with one callback at the end. The segment array must
+  // stay valid until then, and no segment may be a single byte read.
+  bool transferAsync(SPISettings settings, int csPin, const SPISegment *segments, size_t segmentCount, SPICallback callback, void *arg = NULL);
+
+  // Queues a send-only transfer, e.g. a display framebuffer. With a stream
+  // timer set, blocks in RAM go out as one EasyDMA array list: chunk after
+  // chunk with no gaps, however late the interrupt is serviced.
+  bool streamAsync(const void *txBuf, size_t count, SPICallback callback, void *arg = NULL);
+
+#ifdef NRF52
+  // Lets GPIOTE and PPI drive csPin low when SPIM starts and high when it
+  // ends, so each transfer() call is framed without digitalWrite(). Single
+  // byte transfers and blocks of more than one DMA chunk release CS from
+  // the CPU. Pass -1 to turn it off. Uses a GPIOTE channel and PPI
+  // channels 10-11; only one SPIClass instance can have it at a time.
+  bool setHardwareCS(int csPin);
+
+  // Counts SPIM END events on timer (NRF_TIMER3 or NRF_TIMER4, and fails
+  // while SoftUart or an analog stream has it) to chain array list chunks
+  // in hardware. Uses PPI channels 12-14 and PPI groups 0-1; only one
+  // SPIClass instance can have it at a time. NULL hands the timer back.
+  bool setStreamTimer(NRF_TIMER_Type *timer);
+#endif
+
+  void onService(void);
 
   // Transaction Functions
   void usingInterrupt(int interruptNumber);
@@ -100,10 +160,10 @@ class SPIClass {
   void attachInterrupt();
   void detachInterrupt();
 
-#ifdef ARDUINO_GENERIC
+  // Moves the port to other pins; call before begin()
   void setPins(uint8_t uc_pinMISO, uint8_t uc_pinSCK, uint8_t uc_pinMOSI);
-#endif // ARDUINO_GENERIC
-  void begin();
+  // Fails on nRF52 while a TWI or SPI slave uses the same instance
+  bool begin();
   void end();
 
   void setBitOrder(BitOrder order);
@@ -113,35 +173,72 @@ class SPIClass {
   private:
   void init();
   void config(SPISettings settings);
+  bool asyncPush(const SPISegment &first, const SPISegment *rest, size_t restCount, uint32_t config, uint32_t frequency, int csPin, SPICallback callback, void *arg);
 
   NRF_SPI_Type *_p_spi;
+#ifdef NRF52
+  void enableSpi();
+  void enableSpim();
+  void dmaTransfer(const uint8_t *tx, uint8_t *rx, size_t count);
+  void syncBegin();
+  void syncEnd();
+  void asyncNext();
+  void asyncChunk();
+  void csBegin(bool multiChunk);
+  void csEnd();
+
+  // The same instance works as SPI for single bytes and as SPIM for blocks
+  NRF_SPIM_Type *_p_spim;
+  uint32_t _enable;
+  IRQn_Type _IRQn;
+
+  struct AsyncTransfer {
+    const uint8_t *tx;
+    uint8_t *rx;
+    size_t count;
+    const SPISegment *next;         // segments still to run under this CS
+    size_t nextCount;
+    uint32_t config;
+    uint32_t frequency;
+    uint8_t csPin;                  // 0xFF for none
+    SPICallback callback;
+    void *arg;
+  };
+
+  AsyncTransfer _asyncQueue[SPI_ASYNC_QUEUE_SIZE];
+  volatile uint8_t _asyncHead;      // next to run (or running)
+  volatile uint8_t _asyncTail;      // next free entry
+  volatile bool _asyncBusy;         // the head transfer is on the bus
+  volatile uint8_t _syncBusy;       // synchronous calls using the bus (nested)
+  uint8_t _asyncChunkLen;
+  uint16_t _asyncListChunks;        // chunks in the array list on the bus, 0 for none
+  int8_t _csGpiote;                 // GPIOTE channel driving CS, -1 for none
+  bool _csHeld;                     // CS kept low across several transfers
+  NRF_TIMER_Type *_streamTimer;
+  uint8_t _asyncBounce[64];         // TX chunks from flash
+#endif
+
+  // settings of the synchronous API, restored after queued transfers
+  SPISettings _settings;
   uint8_t _uc_pinMiso;
   uint8_t _uc_pinMosi;
   uint8_t _uc_pinSCK;
 
-  uint8_t _dataMode;
-  uint32_t _bitOrder;
-
   bool initialized;
   uint8_t interruptMode;
   char interruptSave;
   uint32_t interruptMask;
 };
 
-void SPIClass::transfer(void *buf, size_t count)
-{
-  // TODO: Optimize for faster block-transfer
-  uint8_t *buffer = reinterpret_cast<uint8_t *>(buf);
-  for (size_t i=0; i<count; i++)
-    buffer[i] = transfer(buffer[i]);
-}
-
 #if SPI_INTERFACES_COUNT > 0
 extern SPIClass SPI;
 #endif
 #if SPI_INTERFACES_COUNT > 1
 extern SPIClass SPI1;
 #endif
+#if SPI_INTERFACES_COUNT > 2
+extern SPIClass SPI2;
+#endif
 
 // For compatibility with sketches designed for AVR @ 16 MHz
 // New programs should use SPI.beginTransaction to set the SPI clock
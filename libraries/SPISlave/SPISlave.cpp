@@ -0,0 +1,196 @@
+/*
+ * SPI Slave library for nRF52.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef NRF52
+
+#include "SPISlave.h"
+#include <Arduino.h>
+#include <wiring_private.h>
+
+static void spiSlaveIrq(void *arg)
+{
+  static_cast<SPISlave *>(arg)->onService();
+}
+
+SPISlave::SPISlave(NRF_SPIS_Type *p_spis, uint8_t uc_pinMISO, uint8_t uc_pinSCK, uint8_t uc_pinMOSI, uint8_t uc_pinCSN)
+{
+  _p_spis = p_spis;
+
+  if (p_spis == NRF_SPIS0) {
+    _IRQn = SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn;
+  } else if (p_spis == NRF_SPIS1) {
+    _IRQn = SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn;
+  } else {
+    _IRQn = SPIM2_SPIS2_SPI2_IRQn;
+  }
+
+  _callback = NULL;
+  _overflows = 0;
+  _overreads = 0;
+
+  setPins(uc_pinMISO, uc_pinSCK, uc_pinMOSI, uc_pinCSN);
+}
+
+void SPISlave::setPins(uint8_t uc_pinMISO, uint8_t uc_pinSCK, uint8_t uc_pinMOSI, uint8_t uc_pinCSN)
+{
+  _uc_pinMiso = g_ADigitalPinMap[uc_pinMISO];
+  _uc_pinSCK = g_ADigitalPinMap[uc_pinSCK];
+  _uc_pinMosi = g_ADigitalPinMap[uc_pinMOSI];
+  _uc_pinCSN = g_ADigitalPinMap[uc_pinCSN];
+}
+
+bool SPISlave::begin(uint8_t dataMode, BitOrder bitOrder)
+{
+  if (!serialIrqAttach(_IRQn, spiSlaveIrq, this)) {
+    return false;
+  }
+
+  // SPIS drives MISO only while CSN is low
+  NRF_GPIO->PIN_CNF[_uc_pinSCK] = ((uint32_t)GPIO_PIN_CNF_DIR_Input << GPIO_PIN_CNF_DIR_Pos)
+                                | ((uint32_t)GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos);
+  NRF_GPIO->PIN_CNF[_uc_pinMosi] = ((uint32_t)GPIO_PIN_CNF_DIR_Input << GPIO_PIN_CNF_DIR_Pos)
+                                 | ((uint32_t)GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos);
+  NRF_GPIO->PIN_CNF[_uc_pinMiso] = ((uint32_t)GPIO_PIN_CNF_DIR_Input << GPIO_PIN_CNF_DIR_Pos)
+                                 | ((uint32_t)GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos);
+  NRF_GPIO->PIN_CNF[_uc_pinCSN] = ((uint32_t)GPIO_PIN_CNF_DIR_Input << GPIO_PIN_CNF_DIR_Pos)
+                                | ((uint32_t)GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos)
+                                | ((uint32_t)GPIO_PIN_CNF_PULL_Pullup << GPIO_PIN_CNF_PULL_Pos);
+
+  _p_spis->ENABLE = (SPIS_ENABLE_ENABLE_Disabled << SPIS_ENABLE_ENABLE_Pos);
+
+  _p_spis->PSEL.SCK = _uc_pinSCK;
+  _p_spis->PSEL.MISO = _uc_pinMiso;
+  _p_spis->PSEL.MOSI = _uc_pinMosi;
+  _p_spis->PSEL.CSN = _uc_pinCSN;
+
+  // same CONFIG layout as SPI/SPIM
+  _p_spis->CONFIG = SPISettings(0, bitOrder, dataMode).config;
+
+  _p_spis->DEF = 0xFF;
+  _p_spis->ORC = 0xFF;
+
+  _bank = 0;
+  _txLen[0] = 0;
+  _txLen[1] = 0;
+  _ended = false;
+  _overflows = 0;
+  _overreads = 0;
+
+  _p_spis->EVENTS_END = 0x0UL;
+  _p_spis->EVENTS_ENDRX = 0x0UL;
+  _p_spis->EVENTS_ACQUIRED = 0x0UL;
+
+  // the CPU takes the semaphore back as soon as a transaction ends
+  _p_spis->SHORTS = SPIS_SHORTS_END_ACQUIRE_Msk;
+  _p_spis->INTENSET = SPIS_INTENSET_END_Msk | SPIS_INTENSET_ACQUIRED_Msk;
+
+  NVIC_ClearPendingIRQ(_IRQn);
+  NVIC_SetPriority(_IRQn, 2);
+  NVIC_EnableIRQ(_IRQn);
+
+  _p_spis->ENABLE = (SPIS_ENABLE_ENABLE_Enabled << SPIS_ENABLE_ENABLE_Pos);
+
+  // the buffers are handed over once the semaphore is ours
+  _p_spis->TASKS_ACQUIRE = 0x1UL;
+
+  return true;
+}
+
+void SPISlave::end()
+{
+  serialIrqDetach(_IRQn, this);
+
+  _p_spis->INTENCLR = SPIS_INTENCLR_END_Msk | SPIS_INTENCLR_ACQUIRED_Msk;
+  _p_spis->SHORTS = 0;
+  _p_spis->ENABLE = (SPIS_ENABLE_ENABLE_Disabled << SPIS_ENABLE_ENABLE_Pos);
+}
+
+void SPISlave::onTransaction(SPISlaveCallback callback)
+{
+  _callback = callback;
+}
+
+void SPISlave::setDefaultChar(uint8_t c)
+{
+  _p_spis->DEF = c;
+}
+
+void SPISlave::setOverreadChar(uint8_t c)
+{
+  _p_spis->ORC = c;
+}
+
+// Points SPIS at the armed bank and hands the semaphore back
+void SPISlave::arm()
+{
+  _p_spis->RXD.PTR = (uint32_t)_rxBuf[_bank];
+  _p_spis->RXD.MAXCNT = SPISLAVE_BUFFER_SIZE;
+  _p_spis->TXD.PTR = (uint32_t)_txBuf[_bank];
+  _p_spis->TXD.MAXCNT = _txLen[_bank];
+
+  _p_spis->TASKS_RELEASE = 0x1UL;
+}
+
+void SPISlave::onService(void)
+{
+  if (_p_spis->EVENTS_END) {
+    _p_spis->EVENTS_END = 0x0UL;
+    _ended = true;
+  }
+
+  if (_p_spis->EVENTS_ACQUIRED) {
+    _p_spis->EVENTS_ACQUIRED = 0x0UL;
+
+    // the semaphore taken by begin()
+    if (!_ended) {
+      arm();
+      return;
+    }
+
+    _ended = false;
+
+    uint32_t status = _p_spis->STATUS;
+    _p_spis->STATUS = status;
+
+    if (status & SPIS_STATUS_OVERFLOW_Msk) {
+      _overflows++;
+    }
+    if (status & SPIS_STATUS_OVERREAD_Msk) {
+      _overreads++;
+    }
+
+    uint8_t done = _bank;
+    size_t rxCount = _p_spis->RXD.AMOUNT;
+
+    // the other bank holds the previous callback's reply, so the master
+    // gets the semaphore back before this callback runs; the finished bank
+    // is left alone until the next transaction ends
+    _bank ^= 1;
+    arm();
+
+    _txLen[done] = 0;
+
+    if (_callback) {
+      size_t txCount = _callback(_rxBuf[done], rxCount, _txBuf[done], SPISLAVE_BUFFER_SIZE);
+
+      _txLen[done] = (txCount < SPISLAVE_BUFFER_SIZE) ? txCount : SPISLAVE_BUFFER_SIZE;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * SPI Slave library for nRF52.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _SPI_SLAVE_H_INCLUDED
+#define _SPI_SLAVE_H_INCLUDED
+
+#ifdef NRF52
+
+#include <Arduino.h>
+#include <SPI.h>
+
+// Size of each of the two RX and two TX buffers, at most 255 (8 bit MAXCNT)
+#ifndef SPISLAVE_BUFFER_SIZE
+#define SPISLAVE_BUFFER_SIZE 255
+#endif
+
+static_assert(SPISLAVE_BUFFER_SIZE <= 255, "SPIS MAXCNT is 8 bits");
+
+// Called at the end of each transaction with the bytes the master sent. A
+// reply is written to txData (up to txSize bytes) and its length returned.
+// The next transaction is already under way with the reply from the
+// previous callback, so this one goes out in the transaction after that.
+// rxData stays valid, and the callback must return, before the next
+// transaction ends.
+typedef size_t (*SPISlaveCallback)(const uint8_t *rxData, size_t rxCount, uint8_t *txData, size_t txSize);
+
+// SPI slave on SPIS with EasyDMA. Every transaction (CSN low to CSN high)
+// fills one RX buffer and sends one TX buffer with no CPU work per byte;
+// buffers alternate between two banks, so the CPU looks at one while the
+// other is on the bus. The semaphore is only held by the CPU to swap banks
+// at the end of a transaction, before the callback runs.
+class SPISlave {
+  public:
+  SPISlave(NRF_SPIS_Type *p_spis, uint8_t uc_pinMISO, uint8_t uc_pinSCK, uint8_t uc_pinMOSI, uint8_t uc_pinCSN);
+
+  void setPins(uint8_t uc_pinMISO, uint8_t uc_pinSCK, uint8_t uc_pinMOSI, uint8_t uc_pinCSN);
+  // Fails while SPI or Wire uses the same instance
+  bool begin(uint8_t dataMode = SPI_MODE0, BitOrder bitOrder = MSBFIRST);
+  void end();
+
+  void onTransaction(SPISlaveCallback callback);
+
+  // Sent while the CPU holds the semaphore (DEF), and once the TX buffer
+  // runs out (ORC)
+  void setDefaultChar(uint8_t c);
+  void setOverreadChar(uint8_t c);
+
+  // Transactions where the master sent more than SPISLAVE_BUFFER_SIZE
+  // bytes, or clocked out more than the reply, since begin()
+  uint32_t overflows() { return _overflows; }
+  uint32_t overreads() { return _overreads; }
+
+  void onService(void);
+
+  private:
+  void arm();
+
+  NRF_SPIS_Type *_p_spis;
+  IRQn_Type _IRQn;
+
+  SPISlaveCallback _callback;
+  volatile uint32_t _overflows;
+  volatile uint32_t _overreads;
+
+  uint8_t _rxBuf[2][SPISLAVE_BUFFER_SIZE];
+  uint8_t _txBuf[2][SPISLAVE_BUFFER_SIZE];
+  uint8_t _txLen[2];                // reply length in each bank
+  uint8_t _bank;                    // bank armed for the next transaction
+  bool _ended;                      // END seen, ACQUIRED finishes it
+
+  uint8_t _uc_pinMiso;
+  uint8_t _uc_pinMosi;
+  uint8_t _uc_pinSCK;
+  uint8_t _uc_pinCSN;
+};
+
+#endif // NRF52
+
+#endif
@@ -0,0 +1,47 @@
+// SPI Slave Echo
+//
+// Answers each SPI transaction with the bytes received two transactions
+// before, each plus one. The reply is prepared from the transaction callback, so
+// the bytes themselves never pass through loop().
+//
+// Connect the master's MISO, SCK, MOSI and chip select to pins 11, 13, 12
+// and 14, or change the pins below.
+
+#include <SPISlave.h>
+
+SPISlave slave(NRF_SPIS2, 11, 13, 12, 14);
+
+volatile uint32_t transactions = 0;
+
+size_t onTransaction(const uint8_t *rxData, size_t rxCount, uint8_t *txData, size_t txSize)
+{
+  if (rxCount > txSize) {
+    rxCount = txSize;
+  }
+
+  for (size_t i = 0; i < rxCount; i++) {
+    txData[i] = rxData[i] + 1;
+  }
+
+  transactions++;
+
+  return rxCount;
+}
+
+void setup()
+{
+  Serial.begin(115200);
+
+  slave.onTransaction(onTransaction);
+  slave.begin(SPI_MODE0, MSBFIRST);
+}
+
+void loop()
+{
+  delay(1000);
+
+  Serial.print("transactions: ");
+  Serial.print(transactions);
+  Serial.print(", overflows: ");
+  Serial.println(slave.overflows());
+}
@@ -31,20 +31,78 @@
 // WIRE_HAS_END means Wire has end()
 #define WIRE_HAS_END 1
 
+// Size of the TX and RX buffers, may be overridden by the variant or build
+// flags. Must be a power of two.
+#ifndef WIRE_BUFFER_SIZE
+#define WIRE_BUFFER_SIZE SERIAL_BUFFER_SIZE
+#endif
+
+// Largest const write from flash, which EasyDMA cannot read and so is
+// copied to RAM first
+#ifndef WIRE_BOUNCE_BUFFER_SIZE
+#define WIRE_BOUNCE_BUFFER_SIZE 32
+#endif
+
+// Called from the Wire interrupt when an asynchronous transfer is done, with
+// the endTransmission() status (5 for a timeout)
+typedef void (*WireCallback)(uint8_t status, void *arg);
+
+#ifdef NRF52
+// Called at the end of each transaction in register map mode. reg is the
+// register the master addressed, data and written what it wrote after the
+// register number, read how many bytes it read.
+typedef void (*WireRegisterCallback)(uint8_t reg, const uint8_t *data, size_t written, size_t read);
+
+// A register read repeated every period milliseconds by the Wire scheduler.
+// buffer holds two results of length bytes: the newest one is kept while
+// the next is read into the other half.
+class WireJob
+{
+  public:
+    WireJob(uint8_t address, uint8_t reg, uint8_t length, uint32_t period, uint8_t *buffer);
+
+    // Copies the newest result and its micros() timestamp. Returns false
+    // until the first read has completed.
+    bool read(uint8_t *data, uint32_t *timestamp = NULL);
+    uint32_t reads(void) { return _count; }
+    uint32_t errors(void) { return _errors; }
+
+  private:
+    friend class TwoWire;
+
+    uint8_t _address;
+    uint8_t _reg;
+    uint8_t _length;
+    uint8_t *_buffer;
+    uint32_t _period;               // RTC ticks
+    uint32_t _due;
+
+    volatile uint32_t _count;       // the newest result is in half _count & 1
+    volatile uint32_t _errors;
+    volatile uint32_t _timestamps[2];
+
+    WireJob *_next;
+};
+#endif
+
 class TwoWire : public Stream
 {
   public:
 #ifdef NRF52
     TwoWire(NRF_TWIM_Type * p_twim, NRF_TWIS_Type * p_twis, IRQn_Type IRQn, uint8_t pinSDA, uint8_t pinSCL);
+    // NRF_TWIM0 or NRF_TWIM1 with the matching TWIS and interrupt
+    TwoWire(NRF_TWIM_Type * p_twim, uint8_t pinSDA, uint8_t pinSCL);
 #else
     TwoWire(NRF_TWI_Type * p_twi, uint8_t pinSDA, uint8_t pinSCL);
 #endif
-#ifdef ARDUINO_GENERIC
+#if defined(NRF52) || defined(ARDUINO_GENERIC)
+    // Moves the bus to other pins; call before begin()
     void setPins(uint8_t pinSDA, uint8_t pinSCL);
-#endif // ARDUINO_GENERIC
-    void begin();
+#endif
+    // Fail on nRF52 while SPI uses the same instance
+    bool begin();
 #ifdef NRF52
-    void begin(uint8_t);
+    bool begin(uint8_t);
 #endif
     void end();
     void setClock(uint32_t);
@@ -63,20 +121,145 @@ class TwoWire : public Stream
     virtual int read(void);
     virtual int peek(void);
     virtual void flush(void);
+
+    // Gives up on a master transfer after timeout microseconds (0 waits
+    // forever). With reset_with_timeout the bus is then recovered by
+    // clocking SCL until the slave lets go of SDA.
+    void setWireTimeout(uint32_t timeout = 25000, bool reset_with_timeout = true);
+    bool getWireTimeoutFlag(void);
+    void clearWireTimeoutFlag(void);
+
+    // Non-blocking endTransmission() and requestFrom(). They return false
+    // while another transfer is running; the data read is available() once
+    // the callback has been called.
+    bool endTransmissionAsync(bool stopBit, WireCallback callback, void *arg = NULL);
+    bool requestFromAsync(uint8_t address, size_t quantity, bool stopBit, WireCallback callback, void *arg = NULL);
+    bool isBusy(void) { return _busy; }
+
+    void onService(void);
+    void onTimeout(void);
+
 #ifdef NRF52
+    // Writes txBuf (e.g. a register number) and reads rxLen bytes back
+    // after a repeated start, as one hardware sequence. Returns the
+    // endTransmission() status.
+    uint8_t writeThenRead(uint8_t address, const uint8_t *txBuf, size_t txLen, uint8_t *rxBuf, size_t rxLen, bool stopBit = true);
+    bool writeThenReadAsync(uint8_t address, const uint8_t *txBuf, size_t txLen, uint8_t *rxBuf, size_t rxLen, bool stopBit, WireCallback callback, void *arg = NULL);
+
+    // Transfers by EasyDMA straight from and to the caller's buffers,
+    // without going through the TX and RX buffers. Writes are limited to
+    // 255 bytes (WIRE_BOUNCE_BUFFER_SIZE from flash). Longer reads are
+    // chained as repeated start reads of 255 bytes at most, which EEPROMs
+    // and sensor FIFOs continue where the previous one stopped. readBuffer()
+    // returns the number of bytes read.
+    uint8_t writeBuffer(uint8_t address, const uint8_t *data, size_t len, bool stopBit = true);
+    size_t readBuffer(uint8_t address, uint8_t *data, size_t len, bool stopBit = true);
+    bool writeBufferAsync(uint8_t address, const uint8_t *data, size_t len, bool stopBit, WireCallback callback, void *arg = NULL);
+    bool readBufferAsync(uint8_t address, uint8_t *data, size_t len, bool stopBit, WireCallback callback, void *arg = NULL);
+
+    // Adds a job to the scheduler, which runs due jobs back to back from
+    // the interrupt, the most overdue first. Blocking transfers get the
+    // bus between two jobs.
+    bool schedule(WireJob &job);
+    void unschedule(WireJob &job);
+
     void onReceive(void(*)(int));
     void onRequest(void(*)(void));
-    void onService(void);
+
+    // Register map mode for slaves: reads are served by EasyDMA straight
+    // from regs, from the register number the master wrote last, with no
+    // onRequest() call. Writes land in rxBuf, register number first. regs
+    // may change at any time, but a read in progress can see half of an
+    // update. NULL regs goes back to onReceive()/onRequest(). Fails, with
+    // nothing changed, for an empty regs or rxBuf.
+    bool setRegisterMap(uint8_t *regs, size_t size, uint8_t *rxBuf, size_t rxSize);
+    void onRegisterAccess(WireRegisterCallback callback);
+
+    void onSchedule(void);
+
+    // Timeouts and scheduled jobs, from RTC2_IRQHandler. That handler is
+    // weak: a sketch that needs RTC2's interrupt can define its own and
+    // call this from it.
+    static void rtcService(void);
 #endif
 
     using Print::write;
 
   private:
+    bool masterStart(uint8_t address, const uint8_t *tx, size_t txLen, uint8_t *rx, size_t rxLen, bool stopBit, WireCallback callback, void *arg);
+    void masterWait(void);
+    void masterService(void);
+    void masterFinish(uint8_t status);
+    void recoverBus(void);
+    bool irqBlocked(void);
+
+    // Master transfer in progress
+    volatile bool _busy;
+    volatile uint8_t _status;
+    bool _stopBit;
+    bool _rxToBuffer;               // reading into rxBuffer
+    uint32_t _errorSrc;
+    size_t _rxAmount;
+    WireCallback _callback;
+    void *_callbackArg;
+
+    uint32_t _timeoutTicks;
+    bool _resetOnTimeout;
+    volatile bool _timeoutFlag;
 #ifdef NRF52
+    volatile bool _timeoutDue;      // expired, handled in the TWIM interrupt
+#endif
+
+#ifdef NRF52
+    bool masterRun(uint8_t address, const uint8_t *tx, size_t txLen, uint8_t *rx, size_t rxLen, bool stopBit);
+    void masterAcquire(void);
+    void masterRelease(void);
+    void masterChain(void);
+    static void jobDone(uint8_t status, void *arg);
+    void registerArm(void);
+    void registerService(void);
+
     NRF_TWIM_Type * _p_twim;
     NRF_TWIS_Type * _p_twis;
+
+    // Chained reads: chunks on the bus, programmed next and still to come
+    uint8_t *_rxNext;
+    size_t _rxLeft;
+    size_t _rxChunk;
+    size_t _rxActive;
+    size_t _rxQueued;
+    size_t _rxBefore;             // bytes of the chunks already read
+
+    uint8_t _bounce[WIRE_BOUNCE_BUFFER_SIZE];
+
+    // Scheduler: jobs wait while the bus is held without a STOP or a
+    // blocking transfer is waiting for it
+    WireJob *_jobs;
+    WireJob * volatile _job;
+    bool _held;
+    volatile bool _syncWaiting;
+
+    // Slave register map
+    uint8_t *_regs;
+    size_t _regsSize;
+    uint8_t *_regRx;
+    size_t _regRxSize;
+    uint8_t _regOffset;
+    bool _regWritten;
+    bool _regRead;
+    WireRegisterCallback _regCallback;
+
+    // TWIM instance, picks the RTC2 compare channel for timeouts and the
+    // PPI channel for chained reads
+    uint8_t _instance;
 #else
     NRF_TWI_Type * _p_twi;
+
+    // Bytes still to move; TWI has no EasyDMA
+    const uint8_t *_txNext;
+    size_t _txLeft;
+    uint8_t *_rxNext;
+    size_t _rxLeft;
 #endif
 
     IRQn_Type _IRQn;
@@ -90,10 +273,10 @@ class TwoWire : public Stream
     bool suspended;
 
     // RX Buffer
-    RingBuffer rxBuffer;
+    RingBufferN<WIRE_BUFFER_SIZE> rxBuffer;
 
     // TX buffer
-    RingBuffer txBuffer;
+    RingBufferN<WIRE_BUFFER_SIZE> txBuffer;
     uint8_t txAddress;
 
     // Callback user functions
@@ -107,5 +290,8 @@ class TwoWire : public Stream
 #if WIRE_INTERFACES_COUNT > 0
 extern TwoWire Wire;
 #endif
+#if WIRE_INTERFACES_COUNT > 1
+extern TwoWire Wire1;
+#endif
 
 #endif
@@ -30,13 +30,48 @@ extern "C" {
 
 #include "Wire.h"
 
+// TWI has no EasyDMA, so transfers are moved a byte at a time by the
+// interrupt. For reads, PPI connects BB to SUSPEND (STOP before the last
+// byte), so the TWI holds SCL low after each byte until the interrupt has
+// taken it from RXD and nothing is lost while the SoftDevice has the CPU.
+// Channels 8 and up belong to the SoftDevice.
+#ifndef WIRE_PPI_CH
+#define WIRE_PPI_CH 7
+#endif
+
+// Transfer timeouts, in 32 us ticks of a one-shot 16 bit timer
+#ifndef WIRE_TIMER
+#define WIRE_TIMER NRF_TIMER2
+#define WIRE_TIMER_IRQn TIMER2_IRQn
+#endif
+#define WIRE_TIMER_PRESCALER 9
+
+static TwoWire *timeoutOwner;
+
+// pin configuration of an idle master bus
+static void masterPin(uint8_t pin)
+{
+  NRF_GPIO->PIN_CNF[pin] = ((uint32_t)GPIO_PIN_CNF_DIR_Input        << GPIO_PIN_CNF_DIR_Pos)
+                         | ((uint32_t)GPIO_PIN_CNF_INPUT_Connect    << GPIO_PIN_CNF_INPUT_Pos)
+                         | ((uint32_t)GPIO_PIN_CNF_PULL_Pullup      << GPIO_PIN_CNF_PULL_Pos)
+                         | ((uint32_t)GPIO_PIN_CNF_DRIVE_S0D1       << GPIO_PIN_CNF_DRIVE_Pos)
+                         | ((uint32_t)GPIO_PIN_CNF_SENSE_Disabled   << GPIO_PIN_CNF_SENSE_Pos);
+}
+
 TwoWire::TwoWire(NRF_TWI_Type * p_twi, uint8_t pinSDA, uint8_t pinSCL)
 {
   this->_p_twi = p_twi;
+  this->_IRQn = (p_twi == NRF_TWI0) ? SPI0_TWI0_IRQn : SPI1_TWI1_IRQn;
   this->_uc_pinSDA = g_ADigitalPinMap[pinSDA];
   this->_uc_pinSCL = g_ADigitalPinMap[pinSCL];
   this->transmissionBegun = false;
   this->suspended = false;
+
+  _busy = false;
+  _status = 0;
+  _callback = NULL;
+  _timeoutFlag = false;
+  setWireTimeout();
 }
 
 #ifdef ARDUINO_GENERIC
@@ -47,29 +82,55 @@ void TwoWire::setPins(uint8_t pinSDA, uint8_t pinSCL)
 }
 #endif // ARDUINO_GENERIC
 
-void TwoWire::begin(void) {
+bool TwoWire::begin(void) {
   //Master Mode
   master = true;
+  _busy = false;
+  suspended = false;
 
-  NRF_GPIO->PIN_CNF[_uc_pinSCL] = ((uint32_t)GPIO_PIN_CNF_DIR_Input        << GPIO_PIN_CNF_DIR_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_INPUT_Connect    << GPIO_PIN_CNF_INPUT_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_PULL_Pullup      << GPIO_PIN_CNF_PULL_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_DRIVE_S0D1       << GPIO_PIN_CNF_DRIVE_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_SENSE_Disabled   << GPIO_PIN_CNF_SENSE_Pos);
-
-  NRF_GPIO->PIN_CNF[_uc_pinSDA] = ((uint32_t)GPIO_PIN_CNF_DIR_Input        << GPIO_PIN_CNF_DIR_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_INPUT_Connect    << GPIO_PIN_CNF_INPUT_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_PULL_Pullup      << GPIO_PIN_CNF_PULL_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_DRIVE_S0D1       << GPIO_PIN_CNF_DRIVE_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_SENSE_Disabled   << GPIO_PIN_CNF_SENSE_Pos);
+  masterPin(_uc_pinSCL);
+  masterPin(_uc_pinSDA);
 
   _p_twi->FREQUENCY = (TWI_FREQUENCY_FREQUENCY_K100 << TWI_FREQUENCY_FREQUENCY_Pos);
   _p_twi->ENABLE = (TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos);
   _p_twi->PSELSCL = _uc_pinSCL;
   _p_twi->PSELSDA = _uc_pinSDA;
+
+  _p_twi->INTENCLR = 0xFFFFFFFFUL;
+  _p_twi->SHORTS = 0;
+
+  NRF_PPI->CH[WIRE_PPI_CH].EEP = (uint32_t)&_p_twi->EVENTS_BB;
+  NRF_PPI->CHENCLR = (1UL << WIRE_PPI_CH);
+
+  // a slave reset in the middle of a read can still be holding SDA
+  if (!(NRF_GPIO->IN & (1UL << _uc_pinSDA))) {
+    recoverBus();
+  }
+
+  WIRE_TIMER->TASKS_STOP = 0x1UL;
+  WIRE_TIMER->MODE = TIMER_MODE_MODE_Timer;
+  WIRE_TIMER->BITMODE = TIMER_BITMODE_BITMODE_16Bit;
+  WIRE_TIMER->PRESCALER = WIRE_TIMER_PRESCALER;
+  WIRE_TIMER->SHORTS = TIMER_SHORTS_COMPARE0_STOP_Msk;
+  WIRE_TIMER->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+  timeoutOwner = this;
+
+  NVIC_ClearPendingIRQ(WIRE_TIMER_IRQn);
+  // S130 keeps priorities 0 and 2 for itself, and refuses to start while
+  // an enabled interrupt uses one of them
+  NVIC_SetPriority(WIRE_TIMER_IRQn, 3);
+  NVIC_EnableIRQ(WIRE_TIMER_IRQn);
+
+  NVIC_ClearPendingIRQ(_IRQn);
+  NVIC_SetPriority(_IRQn, 3);
+  NVIC_EnableIRQ(_IRQn);
+
+  return true;
 }
 
 void TwoWire::setClock(uint32_t baudrate) {
+  masterWait();
+
   _p_twi->ENABLE = (TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos);
 
   uint32_t frequency;
@@ -92,6 +153,12 @@ void TwoWire::setClock(uint32_t baudrate) {
 }
 
 void TwoWire::end() {
+  masterWait();
+
+  NVIC_DisableIRQ(_IRQn);
+  NVIC_DisableIRQ(WIRE_TIMER_IRQn);
+  timeoutOwner = NULL;
+
   _p_twi->ENABLE = (TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos);
 }
 
@@ -101,67 +168,35 @@ uint8_t TwoWire::requestFrom(uint8_t address, size_t quantity, bool stopBit)
   {
     return 0;
   }
-  if (quantity > SERIAL_BUFFER_SIZE)
+  if (quantity > sizeof(rxBuffer._aucBuffer))
   {
-    quantity = SERIAL_BUFFER_SIZE;
+    quantity = sizeof(rxBuffer._aucBuffer);
   }
 
-  size_t byteRead = 0;
-  rxBuffer.clear();
-
-  _p_twi->ADDRESS = address;
-  _p_twi->SHORTS = 0x1UL;    // To trigger suspend task when a byte is received
-
-  if (!this->suspended) {
-    _p_twi->TASKS_RESUME = 0x1UL;
-    _p_twi->TASKS_STARTRX = 0x1UL;
-  }
+  masterWait();
 
-  for (byteRead = 0; byteRead < quantity; byteRead++)
-  {
-    if (byteRead == quantity - 1)
-    {
-      // To trigger stop task when last byte is received, set before resume task.
-      if (stopBit) {
-        _p_twi->SHORTS = 0x2UL;
-      }
-    }
-
-    _p_twi->TASKS_RESUME = 0x1UL;
-
-    while (!_p_twi->EVENTS_RXDREADY && !_p_twi->EVENTS_ERROR);
-
-    if (_p_twi->EVENTS_ERROR)
-    {
-      break;
-    }
+  rxBuffer.clear();
 
-    _p_twi->EVENTS_RXDREADY = 0x0UL;
+  masterStart(address, NULL, 0, rxBuffer._aucBuffer, quantity, stopBit, NULL, NULL);
+  masterWait();
 
-    rxBuffer.store_char(_p_twi->RXD);
-  }
+  return _rxAmount;
+}
 
-  if (stopBit || _p_twi->EVENTS_ERROR)
+bool TwoWire::requestFromAsync(uint8_t address, size_t quantity, bool stopBit, WireCallback callback, void *arg)
+{
+  if (_busy || quantity == 0)
   {
-    this->suspended = false;
-    _p_twi->TASKS_STOP = 0x1UL;
-    while(!_p_twi->EVENTS_STOPPED);
-    _p_twi->EVENTS_STOPPED = 0x0UL;
+    return false;
   }
-  else
+  if (quantity > sizeof(rxBuffer._aucBuffer))
   {
-    this->suspended = true;
-    _p_twi->TASKS_SUSPEND = 0x1UL;
-    while(!_p_twi->EVENTS_SUSPENDED);
-    _p_twi->EVENTS_SUSPENDED = 0x0UL;
+    quantity = sizeof(rxBuffer._aucBuffer);
   }
 
-  if (_p_twi->EVENTS_ERROR)
-  {
-    _p_twi->EVENTS_ERROR = 0x0UL;
-  }
+  rxBuffer.clear();
 
-  return byteRead;
+  return masterStart(address, NULL, 0, rxBuffer._aucBuffer, quantity, stopBit, callback, arg);
 }
 
 uint8_t TwoWire::requestFrom(uint8_t address, size_t quantity)
@@ -183,66 +218,29 @@ void TwoWire::beginTransmission(uint8_t address) {
 //  2 : NACK on transmit of address
 //  3 : NACK on transmit of data
 //  4 : Other error
+//  5 : Timeout
 uint8_t TwoWire::endTransmission(bool stopBit)
 {
   transmissionBegun = false;
 
-  // Start I2C transmission
-  _p_twi->ADDRESS = txAddress;
-  _p_twi->SHORTS = 0x0UL;
-  _p_twi->TASKS_RESUME = 0x1UL;
-  _p_twi->TASKS_STARTTX = 0x1UL;
-
-  while (txBuffer.available())
-  {
-    _p_twi->TXD = txBuffer.read_char();
+  masterWait();
 
-    while(!_p_twi->EVENTS_TXDSENT && !_p_twi->EVENTS_ERROR);
+  masterStart(txAddress, txBuffer._aucBuffer, txBuffer.available(), NULL, 0, stopBit, NULL, NULL);
+  masterWait();
 
-    if (_p_twi->EVENTS_ERROR)
-    {
-      break;
-    }
-
-    _p_twi->EVENTS_TXDSENT = 0x0UL;
-  }
+  return _status;
+}
 
-  if (stopBit || _p_twi->EVENTS_ERROR)
-  {
-    _p_twi->TASKS_STOP = 0x1UL;
-    while(!_p_twi->EVENTS_STOPPED);
-    _p_twi->EVENTS_STOPPED = 0x0UL;
-  }
-  else
+bool TwoWire::endTransmissionAsync(bool stopBit, WireCallback callback, void *arg)
+{
+  if (_busy)
   {
-    _p_twi->TASKS_SUSPEND = 0x1UL;
-    while(!_p_twi->EVENTS_SUSPENDED);
-    _p_twi->EVENTS_SUSPENDED = 0x0UL;
+    return false;
   }
 
-  if (_p_twi->EVENTS_ERROR)
-  {
-    _p_twi->EVENTS_ERROR = 0x0UL;
-
-    uint32_t error = _p_twi->ERRORSRC;
-
-    _p_twi->ERRORSRC = error;
-
-    if (error == TWI_ERRORSRC_ANACK_Msk)
-    {
-      return 2;
-    }
-    else if (error == TWI_ERRORSRC_DNACK_Msk)
-    {
-      return 3;
-    }
-    else
-    {
-      return 4;
-    }
-  }
+  transmissionBegun = false;
 
-  return 0;
+  return masterStart(txAddress, txBuffer._aucBuffer, txBuffer.available(), NULL, 0, stopBit, callback, arg);
 }
 
 uint8_t TwoWire::endTransmission()
@@ -298,8 +296,315 @@ void TwoWire::flush(void)
   // data transfer.
 }
 
+void TwoWire::setWireTimeout(uint32_t timeout, bool reset_with_timeout)
+{
+  uint32_t ticks = (uint32_t)(((uint64_t)timeout * (16000000 >> WIRE_TIMER_PRESCALER) + 999999) / 1000000);
+
+  _timeoutTicks = (ticks > 0xFFFF) ? 0xFFFF : ticks;
+  _resetOnTimeout = reset_with_timeout;
+}
+
+bool TwoWire::getWireTimeoutFlag(void)
+{
+  return _timeoutFlag;
+}
+
+void TwoWire::clearWireTimeoutFlag(void)
+{
+  _timeoutFlag = false;
+}
+
+bool TwoWire::irqBlocked(void)
+{
+  uint32_t ipsr = __get_IPSR();
+
+  return __get_PRIMASK() || (ipsr && NVIC_GetPriority((IRQn_Type)((int)ipsr - 16)) <= NVIC_GetPriority(_IRQn));
+}
+
+// Starts a master transfer, a write of tx or a read into rx. Without stopBit
+// the bus is left suspended: the next transfer starts with a repeated start,
+// or just carries on after a read.
+bool TwoWire::masterStart(uint8_t address, const uint8_t *tx, size_t txLen, uint8_t *rx, size_t rxLen, bool stopBit, WireCallback callback, void *arg)
+{
+  // async transfers may be started from any interrupt, so masking the TWI
+  // interrupt alone does not make the claim atomic
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (_busy) {
+    __set_PRIMASK(primask);
+    return false;
+  }
+  _busy = true;
+
+  __set_PRIMASK(primask);
+
+  _stopBit = stopBit;
+  _rxToBuffer = (rx == rxBuffer._aucBuffer);
+  _errorSrc = 0;
+  _rxAmount = 0;
+  _callback = callback;
+  _callbackArg = arg;
+
+  _txNext = tx;
+  _txLeft = txLen;
+  _rxNext = rx;
+  _rxLeft = rxLen;
+
+  _p_twi->EVENTS_STOPPED = 0x0UL;
+  _p_twi->EVENTS_ERROR = 0x0UL;
+  _p_twi->EVENTS_SUSPENDED = 0x0UL;
+  _p_twi->EVENTS_TXDSENT = 0x0UL;
+  _p_twi->EVENTS_RXDREADY = 0x0UL;
+  _p_twi->EVENTS_BB = 0x0UL;
+
+  _p_twi->ADDRESS = address;
+
+  if (_timeoutTicks) {
+    WIRE_TIMER->TASKS_CLEAR = 0x1UL;
+    WIRE_TIMER->CC[0] = _timeoutTicks;
+    WIRE_TIMER->EVENTS_COMPARE[0] = 0x0UL;
+    WIRE_TIMER->TASKS_START = 0x1UL;
+  }
+
+  bool resumeRead = suspended;
+  suspended = false;
+
+  if (rxLen) {
+    NRF_PPI->CH[WIRE_PPI_CH].TEP = (rxLen == 1 && stopBit) ? (uint32_t)&_p_twi->TASKS_STOP : (uint32_t)&_p_twi->TASKS_SUSPEND;
+    NRF_PPI->CHENSET = (1UL << WIRE_PPI_CH);
+
+    _p_twi->INTENSET = TWI_INTENSET_RXDREADY_Msk | TWI_INTENSET_STOPPED_Msk | TWI_INTENSET_ERROR_Msk;
+
+    _p_twi->TASKS_RESUME = 0x1UL;
+
+    // a read left suspended just carries on
+    if (!resumeRead) {
+      _p_twi->TASKS_STARTRX = 0x1UL;
+    }
+  } else {
+    _p_twi->INTENSET = TWI_INTENSET_TXDSENT_Msk | TWI_INTENSET_STOPPED_Msk | TWI_INTENSET_ERROR_Msk
+                     | (stopBit ? 0 : TWI_INTENSET_SUSPENDED_Msk);
+
+    _p_twi->TASKS_RESUME = 0x1UL;
+    _p_twi->TASKS_STARTTX = 0x1UL;
+
+    if (_txLeft) {
+      _txLeft--;
+      _p_twi->TXD = *_txNext++;
+    } else if (stopBit) {
+      _p_twi->TASKS_STOP = 0x1UL;
+    } else {
+      _p_twi->TASKS_SUSPEND = 0x1UL;
+    }
+  }
+
+  return true;
+}
+
+// Waits for the master transfer in progress, sleeping until the interrupt
+void TwoWire::masterWait(void)
+{
+  while (_busy) {
+    if (irqBlocked()) {
+      // called with the Wire interrupt masked: run the transfer from here
+      masterService();
+
+      if (_busy && WIRE_TIMER->EVENTS_COMPARE[0]) {
+        WIRE_TIMER->EVENTS_COMPARE[0] = 0x0UL;
+        onTimeout();
+      }
+    } else {
+      __WFE();
+    }
+  }
+}
+
+void TwoWire::masterService(void)
+{
+  uint32_t inten = _p_twi->INTENSET;
+
+  if (_p_twi->EVENTS_RXDREADY) {
+    _p_twi->EVENTS_RXDREADY = 0x0UL;
+
+    uint8_t data = _p_twi->RXD;
+
+    if (_rxLeft) {
+      *_rxNext++ = data;
+      _rxLeft--;
+      _rxAmount++;
+    }
+
+    if (_rxLeft == 0) {
+      if (!_stopBit) {
+        // suspended by PPI, the next read can carry on
+        suspended = true;
+        masterFinish(0);
+        return;
+      }
+      // STOPPED follows
+    } else {
+      if (_rxLeft == 1 && _stopBit) {
+        NRF_PPI->CH[WIRE_PPI_CH].TEP = (uint32_t)&_p_twi->TASKS_STOP;
+      }
+      _p_twi->TASKS_RESUME = 0x1UL;
+    }
+  }
+
+  if (_p_twi->EVENTS_TXDSENT) {
+    _p_twi->EVENTS_TXDSENT = 0x0UL;
+
+    if (_txLeft) {
+      _txLeft--;
+      _p_twi->TXD = *_txNext++;
+    } else if (_stopBit) {
+      _p_twi->TASKS_STOP = 0x1UL;
+    } else {
+      _p_twi->TASKS_SUSPEND = 0x1UL;
+    }
+  }
+
+  if (_p_twi->EVENTS_ERROR) {
+    _p_twi->EVENTS_ERROR = 0x0UL;
+
+    _errorSrc = _p_twi->ERRORSRC;
+    _p_twi->ERRORSRC = _errorSrc;
+
+    NRF_PPI->CHENCLR = (1UL << WIRE_PPI_CH);
+    _p_twi->TASKS_RESUME = 0x1UL;
+    _p_twi->TASKS_STOP = 0x1UL;
+  }
+
+  if (_p_twi->EVENTS_SUSPENDED) {
+    _p_twi->EVENTS_SUSPENDED = 0x0UL;
+
+    if (!_errorSrc && (inten & TWI_INTENSET_SUSPENDED_Msk)) {
+      masterFinish(0);
+      return;
+    }
+  }
+
+  if (_p_twi->EVENTS_STOPPED) {
+    _p_twi->EVENTS_STOPPED = 0x0UL;
+
+    if (_errorSrc & TWI_ERRORSRC_ANACK_Msk) {
+      masterFinish(2);
+    } else if (_errorSrc & TWI_ERRORSRC_DNACK_Msk) {
+      masterFinish(3);
+    } else if (_errorSrc) {
+      masterFinish(4);
+    } else {
+      masterFinish(0);
+    }
+  }
+}
+
+void TwoWire::masterFinish(uint8_t status)
+{
+  _p_twi->INTENCLR = 0xFFFFFFFFUL;
+  NRF_PPI->CHENCLR = (1UL << WIRE_PPI_CH);
+
+  WIRE_TIMER->TASKS_STOP = 0x1UL;
+  WIRE_TIMER->EVENTS_COMPARE[0] = 0x0UL;
+
+  if (_rxToBuffer) {
+    rxBuffer.advanceHead(_rxAmount);
+  }
+
+  _status = status;
+  _busy = false;
+
+  if (_callback) {
+    _callback(status, _callbackArg);
+  }
+}
+
+void TwoWire::onService(void)
+{
+  masterService();
+}
+
+void TwoWire::onTimeout(void)
+{
+  if (!_busy) {
+    return;
+  }
+
+  _p_twi->INTENCLR = 0xFFFFFFFFUL;
+  NRF_PPI->CHENCLR = (1UL << WIRE_PPI_CH);
+
+  _p_twi->TASKS_RESUME = 0x1UL;
+  _p_twi->TASKS_STOP = 0x1UL;
+
+  // a slave stretching SCL forever keeps the STOP from going out
+  for (int i = 0; i < 100 && !_p_twi->EVENTS_STOPPED; i++) {
+    delayMicroseconds(1);
+  }
+  _p_twi->EVENTS_STOPPED = 0x0UL;
+  _p_twi->EVENTS_ERROR = 0x0UL;
+  _p_twi->EVENTS_SUSPENDED = 0x0UL;
+  suspended = false;
+
+  if (_resetOnTimeout) {
+    recoverBus();
+  }
+
+  _timeoutFlag = true;
+  masterFinish(5);
+}
+
+// Clocks SCL by hand until a slave stuck in the middle of a byte releases
+// SDA, then sends a STOP (I2C spec 3.1.16)
+void TwoWire::recoverBus(void)
+{
+  _p_twi->ENABLE = (TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos);
+
+  uint32_t scl = (1UL << _uc_pinSCL);
+  uint32_t sda = (1UL << _uc_pinSDA);
+
+  NRF_GPIO->OUTSET = scl | sda;
+  NRF_GPIO->DIRSET = scl | sda;
+
+  for (int i = 0; i < 9 && !(NRF_GPIO->IN & sda); i++) {
+    NRF_GPIO->OUTCLR = scl;
+    delayMicroseconds(5);
+    NRF_GPIO->OUTSET = scl;
+    delayMicroseconds(5);
+  }
+
+  NRF_GPIO->OUTCLR = scl;
+  delayMicroseconds(5);
+  NRF_GPIO->OUTCLR = sda;
+  delayMicroseconds(5);
+  NRF_GPIO->OUTSET = scl;
+  delayMicroseconds(5);
+  NRF_GPIO->OUTSET = sda;
+  delayMicroseconds(5);
+
+  masterPin(_uc_pinSCL);
+  masterPin(_uc_pinSDA);
+
+  _p_twi->ENABLE = (TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos);
+}
+
+extern "C" void TIMER2_IRQHandler(void)
+{
+  if (WIRE_TIMER->EVENTS_COMPARE[0]) {
+    WIRE_TIMER->EVENTS_COMPARE[0] = 0x0UL;
+
+    if (timeoutOwner) {
+      timeoutOwner->onTimeout();
+    }
+  }
+}
+
 #if WIRE_INTERFACES_COUNT > 0
 TwoWire Wire(NRF_TWI1, PIN_WIRE_SDA, PIN_WIRE_SCL);
+
+extern "C" void SPI1_TWI1_IRQHandler(void)
+{
+  Wire.onService();
+}
 #endif
 
 #endif
@@ -29,6 +29,102 @@ extern "C" {
 
 #include "Wire.h"
 
+// EasyDMA transfer length limit of TWIM and TWIS (8 bit MAXCNT)
+#define TWI_MAXCNT 255
+
+// Master transfer timeouts and the job scheduler. RTC2 runs freely from
+// the 32 kHz clock that millis() already keeps going. Compare channel n is
+// the timeout of TWIM instance n, channel 2 + n its next scheduled job.
+#define WIRE_RTC NRF_RTC2
+#define WIRE_RTC_IRQn RTC2_IRQn
+#define WIRE_RTC_CHANNELS 2
+#define WIRE_RTC_JOB_CH(instance) (WIRE_RTC_CHANNELS + (instance))
+
+// LASTRX -> STARTRX for reads chained past TWI_MAXCNT, 15 for TWIM0 and
+// 16 for TWIM1
+#define WIRE_PPI_CH 15
+
+static TwoWire *rtcOwners[WIRE_RTC_CHANNELS];
+
+static void wireIrq(void *arg)
+{
+  static_cast<TwoWire *>(arg)->onService();
+}
+
+static void rtcStart()
+{
+  static bool running = false;
+
+  if (running) {
+    return;
+  }
+  running = true;
+
+  WIRE_RTC->PRESCALER = 0;
+  WIRE_RTC->TASKS_START = 1;
+
+  NVIC_ClearPendingIRQ(WIRE_RTC_IRQn);
+  NVIC_SetPriority(WIRE_RTC_IRQn, 2);
+  NVIC_EnableIRQ(WIRE_RTC_IRQn);
+}
+
+static bool rtcExpired(uint8_t ch)
+{
+  return (WIRE_RTC->INTENSET & (RTC_INTENSET_COMPARE0_Msk << ch)) && WIRE_RTC->EVENTS_COMPARE[ch];
+}
+
+static void rtcDisarm(uint8_t ch)
+{
+  WIRE_RTC->INTENCLR = RTC_INTENSET_COMPARE0_Msk << ch;
+  WIRE_RTC->EVENTS_COMPARE[ch] = 0;
+}
+
+static void rtcArm(uint8_t ch, uint32_t ticks)
+{
+  // the compare is not guaranteed to fire for COUNTER + 1
+  if (ticks < 2) {
+    ticks = 2;
+  }
+
+  WIRE_RTC->EVENTS_COMPARE[ch] = 0;
+  WIRE_RTC->CC[ch] = (WIRE_RTC->COUNTER + ticks) & RTC_COUNTER_COUNTER_Msk;
+  WIRE_RTC->INTENSET = RTC_INTENSET_COMPARE0_Msk << ch;
+}
+
+// a - b on the 24 bit counter, negative when a is in the past
+static int32_t rtcDiff(uint32_t a, uint32_t b)
+{
+  return (int32_t)((a - b) << 8) >> 8;
+}
+
+static bool txFits(const uint8_t *tx, size_t txLen)
+{
+  // EasyDMA can only read RAM, the rest goes through the bounce buffer
+  if (txLen && (uint32_t)tx < 0x20000000) {
+    return txLen <= WIRE_BOUNCE_BUFFER_SIZE;
+  }
+
+  return txLen <= TWI_MAXCNT;
+}
+
+// pin configuration of an idle master bus
+static void masterPin(uint8_t pin)
+{
+  NRF_GPIO->PIN_CNF[pin] = ((uint32_t)GPIO_PIN_CNF_DIR_Input      << GPIO_PIN_CNF_DIR_Pos)
+                         | ((uint32_t)GPIO_PIN_CNF_INPUT_Connect    << GPIO_PIN_CNF_INPUT_Pos)
+                         | ((uint32_t)GPIO_PIN_CNF_PULL_Pullup      << GPIO_PIN_CNF_PULL_Pos)
+                         | ((uint32_t)GPIO_PIN_CNF_DRIVE_S0D1       << GPIO_PIN_CNF_DRIVE_Pos)
+                         | ((uint32_t)GPIO_PIN_CNF_SENSE_Disabled   << GPIO_PIN_CNF_SENSE_Pos);
+}
+
+TwoWire::TwoWire(NRF_TWIM_Type * p_twim, uint8_t pinSDA, uint8_t pinSCL) :
+  TwoWire(p_twim,
+          (p_twim == NRF_TWIM0) ? NRF_TWIS0 : NRF_TWIS1,
+          (p_twim == NRF_TWIM0) ? SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn : SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn,
+          pinSDA, pinSCL)
+{
+}
+
 TwoWire::TwoWire(NRF_TWIM_Type * p_twim, NRF_TWIS_Type * p_twis, IRQn_Type IRQn, uint8_t pinSDA, uint8_t pinSCL)
 {
   this->_p_twim = p_twim;
@@ -37,43 +133,69 @@ TwoWire::TwoWire(NRF_TWIM_Type * p_twim, NRF_TWIS_Type * p_twis, IRQn_Type IRQn,
   this->_uc_pinSDA = g_ADigitalPinMap[pinSDA];
   this->_uc_pinSCL = g_ADigitalPinMap[pinSCL];
   transmissionBegun = false;
+
+  _busy = false;
+  _held = false;
+  _syncWaiting = false;
+  _status = 0;
+  _callback = NULL;
+  _jobs = NULL;
+  _job = NULL;
+  _regs = NULL;
+  _regCallback = NULL;
+  _instance = (p_twim == NRF_TWIM0) ? 0 : 1;
+  _timeoutFlag = false;
+  _timeoutDue = false;
+  setWireTimeout();
 }
 
-#ifdef ARDUINO_GENERIC
 void TwoWire::setPins(uint8_t pinSDA, uint8_t pinSCL)
 {
   this->_uc_pinSDA = g_ADigitalPinMap[pinSDA];
   this->_uc_pinSCL = g_ADigitalPinMap[pinSCL];
 }
-#endif // ARDUINO_GENERIC
 
-void TwoWire::begin(void) {
+bool TwoWire::begin(void) {
+  // SPIM/SPIS of the same instance would share the registers
+  if (!serialIrqAttach(_IRQn, wireIrq, this)) {
+    return false;
+  }
+
   //Master Mode
   master = true;
+  _busy = false;
 
-    NRF_GPIO->PIN_CNF[_uc_pinSCL] = ((uint32_t)GPIO_PIN_CNF_DIR_Input      << GPIO_PIN_CNF_DIR_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_INPUT_Connect    << GPIO_PIN_CNF_INPUT_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_PULL_Pullup      << GPIO_PIN_CNF_PULL_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_DRIVE_S0D1       << GPIO_PIN_CNF_DRIVE_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_SENSE_Disabled   << GPIO_PIN_CNF_SENSE_Pos);
-
-  NRF_GPIO->PIN_CNF[_uc_pinSDA] = ((uint32_t)GPIO_PIN_CNF_DIR_Input        << GPIO_PIN_CNF_DIR_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_INPUT_Connect    << GPIO_PIN_CNF_INPUT_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_PULL_Pullup      << GPIO_PIN_CNF_PULL_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_DRIVE_S0D1       << GPIO_PIN_CNF_DRIVE_Pos)
-                                | ((uint32_t)GPIO_PIN_CNF_SENSE_Disabled   << GPIO_PIN_CNF_SENSE_Pos);
+  masterPin(_uc_pinSCL);
+  masterPin(_uc_pinSDA);
 
   _p_twim->FREQUENCY = TWIM_FREQUENCY_FREQUENCY_K100;
   _p_twim->ENABLE = (TWIM_ENABLE_ENABLE_Enabled << TWIM_ENABLE_ENABLE_Pos);
   _p_twim->PSEL.SCL = _uc_pinSCL;
   _p_twim->PSEL.SDA = _uc_pinSDA;
 
+  _p_twim->INTENCLR = 0xFFFFFFFFUL;
+  _p_twim->SHORTS = 0;
+
+  // a slave reset in the middle of a read can still be holding SDA
+  if (!(NRF_GPIO->IN & (1UL << _uc_pinSDA))) {
+    recoverBus();
+  }
+
+  rtcOwners[_instance] = this;
+  rtcStart();
+
   NVIC_ClearPendingIRQ(_IRQn);
   NVIC_SetPriority(_IRQn, 2);
   NVIC_EnableIRQ(_IRQn);
+
+  return true;
 }
 
-void TwoWire::begin(uint8_t address) {
+bool TwoWire::begin(uint8_t address) {
+  if (!serialIrqAttach(_IRQn, wireIrq, this)) {
+    return false;
+  }
+
   //Slave mode
   master = false;
 
@@ -98,15 +220,23 @@ void TwoWire::begin(uint8_t address) {
 
   _p_twis->INTENSET = TWIS_INTEN_STOPPED_Msk | TWIS_INTEN_ERROR_Msk | TWIS_INTEN_WRITE_Msk | TWIS_INTEN_READ_Msk;
 
+  if (_regs) {
+    registerArm();
+  }
+
   NVIC_ClearPendingIRQ(_IRQn);
   NVIC_SetPriority(_IRQn, 2);
   NVIC_EnableIRQ(_IRQn);
 
   _p_twis->ENABLE = (TWIS_ENABLE_ENABLE_Enabled << TWIS_ENABLE_ENABLE_Pos);
+
+  return true;
 }
 
 void TwoWire::setClock(uint32_t baudrate) {
   if (master) {
+    masterAcquire();
+
     _p_twim->ENABLE = (TWIM_ENABLE_ENABLE_Disabled << TWIM_ENABLE_ENABLE_Pos);
 
     uint32_t frequency;
@@ -126,18 +256,29 @@ void TwoWire::setClock(uint32_t baudrate) {
 
     _p_twim->FREQUENCY = frequency;
     _p_twim->ENABLE = (TWIM_ENABLE_ENABLE_Enabled << TWIM_ENABLE_ENABLE_Pos);
+
+    masterRelease();
   }
 }
 
 void TwoWire::end() {
   if (master)
   {
+    masterAcquire();
+
+    _jobs = NULL;
+    _syncWaiting = false;
+    rtcDisarm(WIRE_RTC_JOB_CH(_instance));
+
+    rtcOwners[_instance] = NULL;
     _p_twim->ENABLE = (TWIM_ENABLE_ENABLE_Disabled << TWIM_ENABLE_ENABLE_Pos);
   }
   else
   {
     _p_twis->ENABLE = (TWIS_ENABLE_ENABLE_Disabled << TWIS_ENABLE_ENABLE_Pos);
   }
+
+  serialIrqDetach(_IRQn, this);
 }
 
 uint8_t TwoWire::requestFrom(uint8_t address, size_t quantity, bool stopBit)
@@ -146,44 +287,40 @@ uint8_t TwoWire::requestFrom(uint8_t address, size_t quantity, bool stopBit)
   {
     return 0;
   }
+  if(quantity > sizeof(rxBuffer._aucBuffer))
+  {
+    quantity = sizeof(rxBuffer._aucBuffer);
+  }
+  if(quantity > TWI_MAXCNT)
+  {
+    quantity = TWI_MAXCNT;
+  }
 
-  size_t byteRead = 0;
   rxBuffer.clear();
 
-  _p_twim->ADDRESS = address;
+  masterRun(address, NULL, 0, rxBuffer._aucBuffer, quantity, stopBit);
 
-  _p_twim->TASKS_RESUME = 0x1UL;
-  _p_twim->RXD.PTR = (uint32_t)rxBuffer._aucBuffer;
-  _p_twim->RXD.MAXCNT = quantity;
-  _p_twim->TASKS_STARTRX = 0x1UL;
-
-  while(!_p_twim->EVENTS_RXSTARTED && !_p_twim->EVENTS_ERROR);
-  _p_twim->EVENTS_RXSTARTED = 0x0UL;
-
-  while(!_p_twim->EVENTS_LASTRX && !_p_twim->EVENTS_ERROR);
-  _p_twim->EVENTS_LASTRX = 0x0UL;
+  return _rxAmount;
+}
 
-  if (stopBit || _p_twim->EVENTS_ERROR)
+bool TwoWire::requestFromAsync(uint8_t address, size_t quantity, bool stopBit, WireCallback callback, void *arg)
+{
+  if (_busy || quantity == 0)
   {
-    _p_twim->TASKS_STOP = 0x1UL;
-    while(!_p_twim->EVENTS_STOPPED);
-    _p_twim->EVENTS_STOPPED = 0x0UL;
+    return false;
   }
-  else
+  if(quantity > sizeof(rxBuffer._aucBuffer))
   {
-    _p_twim->TASKS_SUSPEND = 0x1UL;
-    while(!_p_twim->EVENTS_SUSPENDED);
-    _p_twim->EVENTS_SUSPENDED = 0x0UL;
+    quantity = sizeof(rxBuffer._aucBuffer);
   }
-
-  if (_p_twim->EVENTS_ERROR)
+  if(quantity > TWI_MAXCNT)
   {
-    _p_twim->EVENTS_ERROR = 0x0UL;
+    quantity = TWI_MAXCNT;
   }
 
-  byteRead = rxBuffer._iHead = _p_twim->RXD.AMOUNT;
+  rxBuffer.clear();
 
-  return byteRead;
+  return masterStart(address, NULL, 0, rxBuffer._aucBuffer, quantity, stopBit, callback, arg);
 }
 
 uint8_t TwoWire::requestFrom(uint8_t address, size_t quantity)
@@ -205,64 +342,68 @@ void TwoWire::beginTransmission(uint8_t address) {
 //  2 : NACK on transmit of address
 //  3 : NACK on transmit of data
 //  4 : Other error
+//  5 : Timeout
 uint8_t TwoWire::endTransmission(bool stopBit)
 {
   transmissionBegun = false ;
 
-  // Start I2C transmission
-  _p_twim->ADDRESS = txAddress;
-
-  _p_twim->TASKS_RESUME = 0x1UL;
+  masterRun(txAddress, txBuffer._aucBuffer, txBuffer.available(), NULL, 0, stopBit);
 
-  _p_twim->TXD.PTR = (uint32_t)txBuffer._aucBuffer;
-  _p_twim->TXD.MAXCNT = txBuffer.available();
+  return _status;
+}
 
-  _p_twim->TASKS_STARTTX = 0x1UL;
+bool TwoWire::endTransmissionAsync(bool stopBit, WireCallback callback, void *arg)
+{
+  if (_busy)
+  {
+    return false;
+  }
 
-  while(!_p_twim->EVENTS_TXSTARTED && !_p_twim->EVENTS_ERROR);
-  _p_twim->EVENTS_TXSTARTED = 0x0UL;
+  transmissionBegun = false;
 
-  if (txBuffer.available()) {
-    while(!_p_twim->EVENTS_LASTTX && !_p_twim->EVENTS_ERROR);
-  }
-  _p_twim->EVENTS_LASTTX = 0x0UL;
+  return masterStart(txAddress, txBuffer._aucBuffer, txBuffer.available(), NULL, 0, stopBit, callback, arg);
+}
 
-  if (stopBit || _p_twim->EVENTS_ERROR)
-  {
-    _p_twim->TASKS_STOP = 0x1UL;
-    while(!_p_twim->EVENTS_STOPPED);
-    _p_twim->EVENTS_STOPPED = 0x0UL;
-  }
-  else
+uint8_t TwoWire::writeThenRead(uint8_t address, const uint8_t *txBuf, size_t txLen, uint8_t *rxBuf, size_t rxLen, bool stopBit)
+{
+  if (!masterRun(address, txBuf, txLen, rxBuf, rxLen, stopBit))
   {
-    _p_twim->TASKS_SUSPEND = 0x1UL;
-    while(!_p_twim->EVENTS_SUSPENDED);
-    _p_twim->EVENTS_SUSPENDED = 0x0UL;
+    return 1;
   }
 
-  if (_p_twim->EVENTS_ERROR)
-  {
-    _p_twim->EVENTS_ERROR = 0x0UL;
+  return _status;
+}
 
-    uint32_t error = _p_twim->ERRORSRC;
+bool TwoWire::writeThenReadAsync(uint8_t address, const uint8_t *txBuf, size_t txLen, uint8_t *rxBuf, size_t rxLen, bool stopBit, WireCallback callback, void *arg)
+{
+  return masterStart(address, txBuf, txLen, rxBuf, rxLen, stopBit, callback, arg);
+}
 
-    _p_twim->ERRORSRC = error;
+uint8_t TwoWire::writeBuffer(uint8_t address, const uint8_t *data, size_t len, bool stopBit)
+{
+  return writeThenRead(address, data, len, NULL, 0, stopBit);
+}
 
-    if (error == TWIM_ERRORSRC_ANACK_Msk)
-    {
-      return 2;
-    }
-    else if (error == TWIM_ERRORSRC_DNACK_Msk)
-    {
-      return 3;
-    }
-    else
-    {
-      return 4;
-    }
+size_t TwoWire::readBuffer(uint8_t address, uint8_t *data, size_t len, bool stopBit)
+{
+  if (len == 0)
+  {
+    return 0;
   }
 
-  return 0;
+  masterRun(address, NULL, 0, data, len, stopBit);
+
+  return _rxAmount;
+}
+
+bool TwoWire::writeBufferAsync(uint8_t address, const uint8_t *data, size_t len, bool stopBit, WireCallback callback, void *arg)
+{
+  return masterStart(address, data, len, NULL, 0, stopBit, callback, arg);
+}
+
+bool TwoWire::readBufferAsync(uint8_t address, uint8_t *data, size_t len, bool stopBit, WireCallback callback, void *arg)
+{
+  return len && masterStart(address, NULL, 0, data, len, stopBit, callback, arg);
 }
 
 uint8_t TwoWire::endTransmission()
@@ -273,7 +414,7 @@ uint8_t TwoWire::endTransmission()
 size_t TwoWire::write(uint8_t ucData)
 {
   // No writing, without begun transmission or a full buffer
-  if ( !transmissionBegun || txBuffer.isFull() )
+  if ( !transmissionBegun || txBuffer.isFull() || txBuffer.available() >= TWI_MAXCNT )
   {
     return 0 ;
   }
@@ -318,6 +459,112 @@ void TwoWire::flush(void)
   // data transfer.
 }
 
+bool TwoWire::setRegisterMap(uint8_t *regs, size_t size, uint8_t *rxBuf, size_t rxSize)
+{
+  // the register number of every write goes to rxBuf[0]
+  if (regs && (size == 0 || rxBuf == NULL || rxSize == 0)) {
+    return false;
+  }
+
+  NVIC_DisableIRQ(_IRQn);
+
+  _regs = regs;
+  _regsSize = size;
+  _regRx = rxBuf;
+  _regRxSize = min(rxSize, TWI_MAXCNT);
+  _regOffset = 0;
+
+  if (!master && _regs && _p_twis->ENABLE) {
+    registerArm();
+  }
+
+  NVIC_EnableIRQ(_IRQn);
+
+  return true;
+}
+
+void TwoWire::onRegisterAccess(WireRegisterCallback callback)
+{
+  _regCallback = callback;
+}
+
+// Readies TWIS for the next transaction in register map mode: writes go
+// to the RX region without stretching the clock
+void TwoWire::registerArm(void)
+{
+  _regWritten = false;
+  _regRead = false;
+
+  _p_twis->RXD.PTR = (uint32_t)_regRx;
+  _p_twis->RXD.MAXCNT = _regRxSize;
+  _p_twis->TASKS_PREPARERX = 0x1UL;
+}
+
+void TwoWire::registerService(void)
+{
+  if (_p_twis->EVENTS_WRITE)
+  {
+    _p_twis->EVENTS_WRITE = 0x0UL;
+
+    _regWritten = true;
+  }
+
+  if (_p_twis->EVENTS_READ)
+  {
+    _p_twis->EVENTS_READ = 0x0UL;
+
+    // the register number ends the write phase of a register read
+    if (_regWritten && _p_twis->RXD.AMOUNT)
+    {
+      _regOffset = _regRx[0];
+    }
+    _regRead = true;
+
+    size_t count = (_regOffset < _regsSize) ? _regsSize - _regOffset : 0;
+
+    // past the end the master gets the ORC byte
+    _p_twis->TXD.PTR = (uint32_t)(_regs + _regOffset);
+    _p_twis->TXD.MAXCNT = min(count, TWI_MAXCNT);
+    _p_twis->TASKS_PREPARETX = 0x1UL;
+  }
+
+  if (_p_twis->EVENTS_STOPPED)
+  {
+    _p_twis->EVENTS_STOPPED = 0x0UL;
+
+    size_t written = _regWritten ? _p_twis->RXD.AMOUNT : 0;
+    size_t read = _regRead ? _p_twis->TXD.AMOUNT : 0;
+
+    if (written && !_regRead)
+    {
+      _regOffset = _regRx[0];
+    }
+
+    uint8_t reg = _regOffset;
+
+    // plain reads carry on after the last one
+    _regOffset += read;
+
+    if (_regCallback && (written || read))
+    {
+      _regCallback(reg, _regRx + 1, written ? written - 1 : 0, read);
+    }
+
+    // a write during the callback is held off by clock stretching
+    registerArm();
+  }
+
+  if (_p_twis->EVENTS_ERROR)
+  {
+    _p_twis->EVENTS_ERROR = 0x0UL;
+
+    uint32_t error = _p_twis->ERRORSRC;
+    _p_twis->ERRORSRC = error;
+
+    _p_twis->TASKS_STOP = 0x1UL;
+  }
+}
+
 void TwoWire::onReceive(void(*function)(int))
 {
   onReceiveCallback = function;
@@ -328,8 +575,405 @@ void TwoWire::onRequest(void(*function)(void))
   onRequestCallback = function;
 }
 
+void TwoWire::setWireTimeout(uint32_t timeout, bool reset_with_timeout)
+{
+  // in 32768 Hz ticks, at least two so the compare cannot be missed
+  _timeoutTicks = timeout ? (uint32_t)(((uint64_t)timeout * 32768 + 999999) / 1000000) + 1 : 0;
+  _resetOnTimeout = reset_with_timeout;
+}
+
+bool TwoWire::getWireTimeoutFlag(void)
+{
+  return _timeoutFlag;
+}
+
+void TwoWire::clearWireTimeoutFlag(void)
+{
+  _timeoutFlag = false;
+}
+
+bool TwoWire::irqBlocked(void)
+{
+  uint32_t ipsr = __get_IPSR();
+
+  return __get_PRIMASK() || (ipsr && NVIC_GetPriority((IRQn_Type)((int)ipsr - 16)) <= NVIC_GetPriority(_IRQn));
+}
+
+// Starts a master transfer: tx (if any) is written, then rx (if any) is
+// read. Without stopBit the bus is left suspended so the next transfer
+// starts with a repeated start. Returns false while busy or if tx is too
+// long.
+bool TwoWire::masterStart(uint8_t address, const uint8_t *tx, size_t txLen, uint8_t *rx, size_t rxLen, bool stopBit, WireCallback callback, void *arg)
+{
+  if (!txFits(tx, txLen)) {
+    return false;
+  }
+
+  // the scheduler starts transfers from the RTC interrupt, so masking the
+  // TWIM interrupt alone does not make the claim atomic
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (_busy) {
+    __set_PRIMASK(primask);
+    return false;
+  }
+  _busy = true;
+  _timeoutDue = false;
+
+  __set_PRIMASK(primask);
+
+  _stopBit = stopBit;
+  _rxToBuffer = (rx == rxBuffer._aucBuffer);
+  _errorSrc = 0;
+  _rxAmount = 0;
+  _rxBefore = 0;
+  _callback = callback;
+  _callbackArg = arg;
+
+  if (txLen && (uint32_t)tx < 0x20000000) {
+    memcpy(_bounce, tx, txLen);
+    tx = _bounce;
+  }
+
+  _p_twim->EVENTS_STOPPED = 0x0UL;
+  _p_twim->EVENTS_ERROR = 0x0UL;
+  _p_twim->EVENTS_SUSPENDED = 0x0UL;
+  _p_twim->EVENTS_TXSTARTED = 0x0UL;
+  _p_twim->EVENTS_LASTRX = 0x0UL;
+  _p_twim->EVENTS_RXSTARTED = 0x0UL;
+
+  _p_twim->ADDRESS = address;
+
+  uint32_t shorts = 0;
+  uint32_t inten = TWIM_INTEN_STOPPED_Msk | TWIM_INTEN_ERROR_Msk;
+
+  if (!stopBit) {
+    inten |= TWIM_INTEN_SUSPENDED_Msk;
+  }
+
+  if (txLen) {
+    _p_twim->TXD.PTR = (uint32_t)tx;
+    _p_twim->TXD.MAXCNT = txLen;
+  }
+
+  if (rxLen) {
+    // longer reads are split into even chunks, so the last is never short
+    size_t chunks = (rxLen + TWI_MAXCNT - 1) / TWI_MAXCNT;
+
+    _rxChunk = (rxLen + chunks - 1) / chunks;
+    _rxActive = 0;
+    _rxQueued = min(_rxChunk, rxLen);
+    _rxNext = rx + _rxQueued;
+    _rxLeft = rxLen - _rxQueued;
+
+    _p_twim->RXD.PTR = (uint32_t)rx;
+    _p_twim->RXD.MAXCNT = _rxQueued;
+
+    // write then read: the read follows with a repeated start
+    if (txLen) {
+      shorts = TWIM_SHORTS_LASTTX_STARTRX_Msk;
+    }
+
+    if (_rxLeft) {
+      // each chunk starts the next, RXSTARTED queues the one after
+      uint8_t ch = WIRE_PPI_CH + _instance;
+
+      NRF_PPI->CH[ch].EEP = (uint32_t)&_p_twim->EVENTS_LASTRX;
+      NRF_PPI->CH[ch].TEP = (uint32_t)&_p_twim->TASKS_STARTRX;
+      NRF_PPI->CHENSET = (1UL << ch);
+
+      inten |= TWIM_INTEN_RXSTARTED_Msk;
+    } else if (stopBit) {
+      shorts |= TWIM_SHORTS_LASTRX_STOP_Msk;
+    } else {
+      // there is no LASTRX_SUSPEND short
+      inten |= TWIM_INTEN_LASTRX_Msk;
+    }
+  } else if (txLen) {
+    shorts = stopBit ? TWIM_SHORTS_LASTTX_STOP_Msk : TWIM_SHORTS_LASTTX_SUSPEND_Msk;
+  } else {
+    // address only, e.g. a bus scan: stopped once the address went out
+    _p_twim->TXD.MAXCNT = 0;
+
+    inten |= TWIM_INTEN_TXSTARTED_Msk;
+  }
+
+  _p_twim->SHORTS = shorts;
+  _p_twim->INTENSET = inten;
+
+  if (_timeoutTicks) {
+    rtcArm(_instance, _timeoutTicks);
+  }
+
+  // leaves a previous transfer's suspended state
+  _p_twim->TASKS_RESUME = 0x1UL;
+
+  if (rxLen && !txLen) {
+    _p_twim->TASKS_STARTRX = 0x1UL;
+  } else {
+    _p_twim->TASKS_STARTTX = 0x1UL;
+  }
+
+  return true;
+}
+
+// Runs a blocking master transfer. Scheduled jobs are held back from
+// masterAcquire() to masterRelease(), so the caller gets the bus next.
+bool TwoWire::masterRun(uint8_t address, const uint8_t *tx, size_t txLen, uint8_t *rx, size_t rxLen, bool stopBit)
+{
+  if (!txFits(tx, txLen)) {
+    return false;
+  }
+
+  masterAcquire();
+
+  // an asynchronous transfer started from an interrupt can still get in
+  while (!masterStart(address, tx, txLen, rx, rxLen, stopBit, NULL, NULL)) {
+    masterWait();
+  }
+  masterWait();
+
+  masterRelease();
+
+  return true;
+}
+
+void TwoWire::masterAcquire(void)
+{
+  _syncWaiting = true;
+  masterWait();
+}
+
+void TwoWire::masterRelease(void)
+{
+  _syncWaiting = false;
+
+  // jobs that fell due in the meantime
+  if (_jobs) {
+    NVIC_SetPendingIRQ(WIRE_RTC_IRQn);
+  }
+}
+
+// Waits for the master transfer in progress, sleeping until the interrupt
+void TwoWire::masterWait(void)
+{
+  while (_busy) {
+    if (irqBlocked()) {
+      // called with the Wire interrupt masked: finish the transfer here
+      masterService();
+
+      if (_busy && rtcExpired(_instance)) {
+        onTimeout();
+      }
+    } else {
+      __WFE();
+    }
+  }
+}
+
+// RXSTARTED of a chained read: the chunk in RXD is on the bus, so RXD
+// can take the next one. Once the last chunk is running it ends the
+// transfer like an unchained read.
+void TwoWire::masterChain(void)
+{
+  _rxBefore += _rxActive;
+  _rxActive = _rxQueued;
+
+  if (_rxLeft) {
+    _rxQueued = min(_rxChunk, _rxLeft);
+
+    _p_twim->RXD.PTR = (uint32_t)_rxNext;
+    _p_twim->RXD.MAXCNT = _rxQueued;
+
+    _rxNext += _rxQueued;
+    _rxLeft -= _rxQueued;
+  } else {
+    NRF_PPI->CHENCLR = (1UL << (WIRE_PPI_CH + _instance));
+    _p_twim->INTENCLR = TWIM_INTEN_RXSTARTED_Msk;
+
+    if (_stopBit) {
+      _p_twim->SHORTS = TWIM_SHORTS_LASTRX_STOP_Msk;
+    } else {
+      _p_twim->INTENSET = TWIM_INTEN_LASTRX_Msk;
+    }
+  }
+}
+
+void TwoWire::masterService(void)
+{
+  // expired in the RTC interrupt, which leaves the waiting on the bus here
+  if (_timeoutDue) {
+    _timeoutDue = false;
+    onTimeout();
+  }
+
+  uint32_t inten = _p_twim->INTENSET;
+
+  if ((inten & TWIM_INTEN_RXSTARTED_Msk) && _p_twim->EVENTS_RXSTARTED) {
+    _p_twim->EVENTS_RXSTARTED = 0x0UL;
+
+    masterChain();
+    inten = _p_twim->INTENSET;
+  }
+
+  if ((inten & TWIM_INTEN_TXSTARTED_Msk) && _p_twim->EVENTS_TXSTARTED) {
+    _p_twim->EVENTS_TXSTARTED = 0x0UL;
+
+    if (_stopBit) {
+      _p_twim->TASKS_STOP = 0x1UL;
+    } else {
+      _p_twim->TASKS_SUSPEND = 0x1UL;
+    }
+  }
+
+  if ((inten & TWIM_INTEN_LASTRX_Msk) && _p_twim->EVENTS_LASTRX) {
+    _p_twim->EVENTS_LASTRX = 0x0UL;
+
+    _p_twim->TASKS_SUSPEND = 0x1UL;
+  }
+
+  if (_p_twim->EVENTS_ERROR) {
+    _p_twim->EVENTS_ERROR = 0x0UL;
+
+    _errorSrc = _p_twim->ERRORSRC;
+    _p_twim->ERRORSRC = _errorSrc;
+
+    // a NACK suspends the bus when a LASTTX_SUSPEND short is set
+    NRF_PPI->CHENCLR = (1UL << (WIRE_PPI_CH + _instance));
+    _p_twim->SHORTS = 0;
+    _p_twim->TASKS_RESUME = 0x1UL;
+    _p_twim->TASKS_STOP = 0x1UL;
+  }
+
+  if (_p_twim->EVENTS_SUSPENDED) {
+    _p_twim->EVENTS_SUSPENDED = 0x0UL;
+
+    if (!_errorSrc && (inten & TWIM_INTEN_SUSPENDED_Msk)) {
+      masterFinish(0);
+      return;
+    }
+  }
+
+  if (_p_twim->EVENTS_STOPPED) {
+    _p_twim->EVENTS_STOPPED = 0x0UL;
+
+    if (_errorSrc & TWIM_ERRORSRC_ANACK_Msk) {
+      masterFinish(2);
+    } else if (_errorSrc & TWIM_ERRORSRC_DNACK_Msk) {
+      masterFinish(3);
+    } else if (_errorSrc) {
+      masterFinish(4);
+    } else {
+      masterFinish(0);
+    }
+  }
+}
+
+void TwoWire::masterFinish(uint8_t status)
+{
+  _p_twim->INTENCLR = 0xFFFFFFFFUL;
+  _p_twim->SHORTS = 0;
+  NRF_PPI->CHENCLR = (1UL << (WIRE_PPI_CH + _instance));
+
+  rtcDisarm(_instance);
+
+  if (status != 5) {
+    _rxAmount = _rxBefore + _p_twim->RXD.AMOUNT;
+  }
+
+  if (_rxToBuffer) {
+    rxBuffer.advanceHead(_rxAmount);
+  }
+
+  _status = status;
+  _held = !_stopBit && status == 0;
+  _busy = false;
+
+  if (_callback) {
+    _callback(status, _callbackArg);
+  }
+
+  onSchedule();
+}
+
+void TwoWire::onTimeout(void)
+{
+  if (!_busy) {
+    return;
+  }
+
+  _p_twim->INTENCLR = 0xFFFFFFFFUL;
+  _p_twim->SHORTS = 0;
+  NRF_PPI->CHENCLR = (1UL << (WIRE_PPI_CH + _instance));
+
+  _p_twim->TASKS_RESUME = 0x1UL;
+  _p_twim->TASKS_STOP = 0x1UL;
+
+  // a slave stretching SCL forever keeps the STOP from going out
+  for (int i = 0; i < 100 && !_p_twim->EVENTS_STOPPED; i++) {
+    delayMicroseconds(1);
+  }
+  _p_twim->EVENTS_STOPPED = 0x0UL;
+  _p_twim->EVENTS_ERROR = 0x0UL;
+  _p_twim->EVENTS_SUSPENDED = 0x0UL;
+
+  if (_resetOnTimeout) {
+    recoverBus();
+  }
+
+  _timeoutFlag = true;
+  masterFinish(5);
+}
+
+// Clocks SCL by hand until a slave stuck in the middle of a byte releases
+// SDA, then sends a STOP (I2C spec 3.1.16)
+void TwoWire::recoverBus(void)
+{
+  _p_twim->ENABLE = (TWIM_ENABLE_ENABLE_Disabled << TWIM_ENABLE_ENABLE_Pos);
+
+  uint32_t scl = (1UL << _uc_pinSCL);
+  uint32_t sda = (1UL << _uc_pinSDA);
+
+  NRF_GPIO->OUTSET = scl | sda;
+  NRF_GPIO->DIRSET = scl | sda;
+
+  for (int i = 0; i < 9 && !(NRF_GPIO->IN & sda); i++) {
+    NRF_GPIO->OUTCLR = scl;
+    delayMicroseconds(5);
+    NRF_GPIO->OUTSET = scl;
+    delayMicroseconds(5);
+  }
+
+  NRF_GPIO->OUTCLR = scl;
+  delayMicroseconds(5);
+  NRF_GPIO->OUTCLR = sda;
+  delayMicroseconds(5);
+  NRF_GPIO->OUTSET = scl;
+  delayMicroseconds(5);
+  NRF_GPIO->OUTSET = sda;
+  delayMicroseconds(5);
+
+  masterPin(_uc_pinSCL);
+  masterPin(_uc_pinSDA);
+
+  _p_twim->ENABLE = (TWIM_ENABLE_ENABLE_Enabled << TWIM_ENABLE_ENABLE_Pos);
+}
+
 void TwoWire::onService(void)
 {
+  if (master)
+  {
+    masterService();
+    return;
+  }
+
+  if (_regs)
+  {
+    registerService();
+    return;
+  }
+
   if (_p_twis->EVENTS_WRITE)
   {
     _p_twis->EVENTS_WRITE = 0x0UL;
@@ -339,7 +983,7 @@ void TwoWire::onService(void)
     rxBuffer.clear();
 
     _p_twis->RXD.PTR = (uint32_t)rxBuffer._aucBuffer;
-    _p_twis->RXD.MAXCNT = sizeof(rxBuffer._aucBuffer);
+    _p_twis->RXD.MAXCNT = min(sizeof(rxBuffer._aucBuffer), TWI_MAXCNT);
 
     _p_twis->TASKS_PREPARERX = 0x1UL;
   }
@@ -374,7 +1018,7 @@ void TwoWire::onService(void)
     {
       int rxAmount = _p_twis->RXD.AMOUNT;
 
-      rxBuffer._iHead = rxAmount;
+      rxBuffer.advanceHead(rxAmount);
 
       if (onReceiveCallback)
       {
@@ -394,16 +1038,206 @@ void TwoWire::onService(void)
   }
 }
 
-TwoWire Wire(NRF_TWIM1, NRF_TWIS1, SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn, PIN_WIRE_SDA, PIN_WIRE_SCL);
+WireJob::WireJob(uint8_t address, uint8_t reg, uint8_t length, uint32_t period, uint8_t *buffer)
+{
+  _address = address;
+  _reg = reg;
+  _length = length;
+  _buffer = buffer;
+  _period = (uint32_t)(((uint64_t)period * 32768 + 500) / 1000);
+  if (_period == 0) {
+    _period = 1;
+  }
 
-#if WIRE_INTERFACES_COUNT > 0
-extern "C"
+  _count = 0;
+  _errors = 0;
+  _next = NULL;
+}
+
+bool WireJob::read(uint8_t *data, uint32_t *timestamp)
 {
-  void SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQHandler(void)
-  {
-    Wire.onService();
+  uint32_t count;
+
+  do {
+    count = _count;
+
+    if (count == 0) {
+      return false;
+    }
+
+    memcpy(data, _buffer + (count & 1) * _length, _length);
+    if (timestamp) {
+      *timestamp = _timestamps[count & 1];
+    }
+
+    // the bank being read is only written again after two more reads
+    // complete, but a newer one is there already
+  } while (count != _count);
+
+  return true;
+}
+
+bool TwoWire::schedule(WireJob &job)
+{
+  if (!master || job._length == 0) {
+    return false;
+  }
+
+  NVIC_DisableIRQ(_IRQn);
+  NVIC_DisableIRQ(WIRE_RTC_IRQn);
+
+  for (WireJob *j = _jobs; j; j = j->_next) {
+    if (j == &job) {
+      NVIC_EnableIRQ(WIRE_RTC_IRQn);
+      NVIC_EnableIRQ(_IRQn);
+      return false;
+    }
+  }
+
+  job._count = 0;
+  job._errors = 0;
+  job._due = WIRE_RTC->COUNTER;
+  job._next = _jobs;
+  _jobs = &job;
+
+  NVIC_EnableIRQ(WIRE_RTC_IRQn);
+  NVIC_EnableIRQ(_IRQn);
+
+  NVIC_SetPendingIRQ(WIRE_RTC_IRQn);
+
+  return true;
+}
+
+void TwoWire::unschedule(WireJob &job)
+{
+  NVIC_DisableIRQ(_IRQn);
+  NVIC_DisableIRQ(WIRE_RTC_IRQn);
+
+  for (WireJob **j = &_jobs; *j; j = &(*j)->_next) {
+    if (*j == &job) {
+      *j = job._next;
+      break;
+    }
+  }
+
+  NVIC_EnableIRQ(WIRE_RTC_IRQn);
+  NVIC_EnableIRQ(_IRQn);
+
+  // its buffer may still be on the bus
+  while (_job == &job) {
+    masterWait();
   }
 }
+
+void TwoWire::jobDone(uint8_t status, void *arg)
+{
+  TwoWire *wire = static_cast<TwoWire *>(arg);
+  WireJob *job = wire->_job;
+
+  wire->_job = NULL;
+
+  if (status == 0 && wire->_rxAmount == job->_length) {
+    job->_timestamps[(job->_count + 1) & 1] = micros();
+    job->_count++;
+  } else {
+    job->_errors++;
+  }
+
+  // stay on the period grid, skipping slots that were missed entirely
+  job->_due += job->_period;
+
+  int32_t late = -rtcDiff(job->_due, WIRE_RTC->COUNTER);
+
+  if (late >= 0) {
+    job->_due += ((uint32_t)late / job->_period + 1) * job->_period;
+  }
+}
+
+// Starts the most overdue job if the bus is free, or sets the RTC for the
+// next one. Runs whenever a transfer finishes, so due jobs go out back to
+// back.
+void TwoWire::onSchedule(void)
+{
+  if (_busy || _held || _syncWaiting || !_jobs) {
+    return;
+  }
+
+  uint32_t now = WIRE_RTC->COUNTER;
+  WireJob *due = NULL;
+  int32_t dueWait = 0;
+  int32_t soonest = 0;
+
+  for (WireJob *j = _jobs; j; j = j->_next) {
+    int32_t wait = rtcDiff(j->_due, now);
+
+    if (wait <= 0) {
+      if (!due || wait < dueWait) {
+        due = j;
+        dueWait = wait;
+      }
+    } else if (!soonest || wait < soonest) {
+      soonest = wait;
+    }
+  }
+
+  if (due) {
+    rtcDisarm(WIRE_RTC_JOB_CH(_instance));
+
+    // written into the bank read() is not looking at
+    _job = due;
+    if (!masterStart(due->_address, &due->_reg, 1, due->_buffer + ((due->_count + 1) & 1) * due->_length, due->_length, true, jobDone, this)) {
+      _job = NULL;
+    }
+  } else {
+    rtcArm(WIRE_RTC_JOB_CH(_instance), soonest);
+  }
+}
+
+void TwoWire::rtcService(void)
+{
+  for (uint8_t i = 0; i < WIRE_RTC_CHANNELS; i++) {
+    TwoWire *wire = rtcOwners[i];
+
+    if (rtcExpired(i)) {
+      rtcDisarm(i);
+
+      // stopping and recovering the bus wait on it, so that is left to
+      // the TWIM interrupt
+      if (wire && wire->_busy) {
+        wire->_timeoutDue = true;
+        NVIC_SetPendingIRQ(wire->_IRQn);
+      }
+    }
+
+    if (rtcExpired(WIRE_RTC_JOB_CH(i))) {
+      rtcDisarm(WIRE_RTC_JOB_CH(i));
+    }
+
+    // also pended by schedule() and masterRelease()
+    if (wire) {
+      wire->onSchedule();
+    }
+  }
+}
+
+// Weak, so that a sketch can take RTC2's interrupt over and call
+// TwoWire::rtcService() from its own handler
+extern "C" __attribute__((weak)) void RTC2_IRQHandler(void)
+{
+  TwoWire::rtcService();
+}
+
+#if WIRE_INTERFACES_COUNT > 1 && !defined(PIN_WIRE1_SDA)
+#define PIN_WIRE1_SDA PIN_WIRE_SDA
+#define PIN_WIRE1_SCL PIN_WIRE_SCL
+#endif
+
+// Wire1 is TWIM0, which cannot run while SPI (SPIM0) is in use
+#if WIRE_INTERFACES_COUNT > 0
+TwoWire Wire(NRF_TWIM1, NRF_TWIS1, SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn, PIN_WIRE_SDA, PIN_WIRE_SCL);
+#endif
+#if WIRE_INTERFACES_COUNT > 1
+TwoWire Wire1(NRF_TWIM0, NRF_TWIS0, SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn, PIN_WIRE1_SDA, PIN_WIRE1_SCL);
 #endif
 
 #endif
@@ -0,0 +1,61 @@
+// Wire Scheduled Reads
+//
+// Polls two sensors at their own rates with the Wire scheduler. The reads
+// run from the Wire interrupt, timed by the RTC, so they keep their period
+// however long loop() takes. loop() only picks up the newest results.
+//
+// The addresses and registers are those of an MPU-6050 style IMU (14 bytes
+// of accelerometer, temperature and gyro from 0x3B) and a light sensor;
+// change them for the parts on your board. (nRF52 only)
+
+#include <Wire.h>
+
+uint8_t imuBuffer[2 * 14];
+uint8_t lightBuffer[2 * 2];
+
+WireJob imu(0x68, 0x3B, 14, 1, imuBuffer);       // every 1 ms
+WireJob light(0x44, 0x00, 2, 100, lightBuffer);  // every 100 ms
+
+void setup()
+{
+  Serial.begin(115200);
+
+  Wire.begin();
+  Wire.setClock(400000);
+
+  // wake the IMU up
+  Wire.beginTransmission(0x68);
+  Wire.write(0x6B);
+  Wire.write((uint8_t)0x00);
+  Wire.endTransmission();
+
+  Wire.schedule(imu);
+  Wire.schedule(light);
+}
+
+void loop()
+{
+  uint8_t data[14];
+  uint32_t timestamp;
+
+  if (imu.read(data, &timestamp)) {
+    int16_t ax = (data[0] << 8) | data[1];
+
+    Serial.print("ax ");
+    Serial.print(ax);
+    Serial.print(" at ");
+    Serial.print(timestamp);
+    Serial.print(" us, ");
+    Serial.print(imu.reads());
+    Serial.print(" reads, ");
+    Serial.print(imu.errors());
+    Serial.println(" errors");
+  }
+
+  if (light.read(data)) {
+    Serial.print("light ");
+    Serial.println((data[0] << 8) | data[1]);
+  }
+
+  delay(500);
+}
@@ -0,0 +1,243 @@
+/*
+  Micro-benchmarks for Uart, SPIClass and TwoWire on the simulated
+  peripherals.
+
+  For each operation it prints the interrupts taken and peripheral
+  registers accessed per call, which stand for the CPU time the driver
+  needs on the target, the simulated bus time against the time the
+  payload alone takes on the wire, and the host time per call. Only a
+  failed transfer fails the run; the figures are for comparing changes.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "Arduino.h"
+#include "SPI.h"
+#include "Wire.h"
+#include "sim.h"
+
+#define ROUNDS 200
+
+#define SPI_IRQ  SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn
+#define WIRE_IRQ SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn
+#define ADDRESS  0x48
+
+static int failures;
+
+static uint64_t hostNs()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Runs op ROUNDS times and prints a row. wire is the time the payload
+// takes at the bus rate, in ns, for the bus use column.
+static void bench(const char *name, bool (*op)(void), int irq, uint64_t wire)
+{
+  uint32_t irqs = hostIrqCount(irq);
+  uint32_t regs = hostRegAccesses();
+  uint64_t bus = hostTime();
+  uint64_t start = hostNs();
+
+  for (int i = 0; i < ROUNDS; i++) {
+    if (!op()) {
+      fprintf(stderr, "%s: transfer failed\n", name);
+      failures++;
+      return;
+    }
+  }
+
+  uint64_t host = hostNs() - start;
+
+  irqs = hostIrqCount(irq) - irqs;
+  regs = hostRegAccesses() - regs;
+  bus = hostTime() - bus;
+
+  printf("%-28s %8.1f %8.1f %10.1f %7.0f%% %10.0f\n", name,
+         (double)irqs / ROUNDS, (double)regs / ROUNDS,
+         (double)bus / ROUNDS / 1000, 100.0 * wire * ROUNDS / bus,
+         (double)host / ROUNDS);
+}
+
+// Uart at 1 Mbaud: 10 bits a byte
+
+static uint8_t data[1024];
+static uint8_t rx[1024];
+static uint8_t sent[1024];
+
+static bool serialPrint()
+{
+  Serial.print("hello, world\n");
+  Serial.flush();
+
+  return hostUartSent(sent, sizeof(sent)) == 13;
+}
+
+static bool serialWrite()
+{
+  Serial.write(data, 1000);
+  Serial.flush();
+
+  return hostUartSent(sent, sizeof(sent)) == 1000 && memcmp(sent, data, 1000) == 0;
+}
+
+static bool serialRead()
+{
+  size_t n = 0;
+
+  // what the RX buffer holds, read as it arrives
+  hostUartReceive(data, SERIAL_RX_BUFFER_SIZE);
+
+  while (n < SERIAL_RX_BUFFER_SIZE) {
+    int c = Serial.read();
+
+    if (c >= 0) {
+      rx[n++] = (uint8_t)c;
+    }
+  }
+
+  return memcmp(rx, data, SERIAL_RX_BUFFER_SIZE) == 0;
+}
+
+// SPI at 8 MHz
+
+static uint8_t spiLoop(uint8_t mosi, void *arg)
+{
+  (void)arg;
+  return mosi;
+}
+
+static bool spiByte()
+{
+  SPI.beginTransaction(SPISettings(8000000, MSBFIRST, SPI_MODE0));
+  uint8_t got = SPI.transfer(0xA5);
+  SPI.endTransaction();
+
+  return got == 0xA5;
+}
+
+static bool spiBlock()
+{
+  SPI.beginTransaction(SPISettings(8000000, MSBFIRST, SPI_MODE0));
+  SPI.transfer(data, rx, sizeof(data));
+  SPI.endTransaction();
+
+  return memcmp(rx, data, sizeof(data)) == 0;
+}
+
+static volatile bool spiDone;
+
+static void spiFinished(void *arg)
+{
+  (void)arg;
+  spiDone = true;
+}
+
+static bool spiStream()
+{
+  spiDone = false;
+
+  if (!SPI.streamAsync(data, sizeof(data), spiFinished)) {
+    return false;
+  }
+
+  while (!spiDone) {
+    __WFE();
+  }
+
+  return true;
+}
+
+// Wire at 400 kHz: 9 bits a byte, plus the address
+
+static HostI2cSlave slave;
+
+static bool wireRegister()
+{
+  uint8_t reg = 0x10;
+  uint8_t value[6];
+
+  return Wire.writeThenRead(ADDRESS, &reg, 1, value, sizeof(value)) == 0 &&
+         value[0] == slave.regs[0x10];
+}
+
+static bool wireWrite()
+{
+  Wire.beginTransmission(ADDRESS);
+  Wire.write(data, 16);
+
+  return Wire.endTransmission() == 0;
+}
+
+static bool wireRead()
+{
+  return Wire.readBuffer(ADDRESS, rx, 512) == 512;
+}
+
+static int run()
+{
+  for (size_t i = 0; i < sizeof(data); i++) {
+    data[i] = (uint8_t)(i * 13);
+  }
+
+  for (int i = 0; i < 256; i++) {
+    slave.regs[i] = (uint8_t)i;
+  }
+  slave.address = ADDRESS;
+
+  printf("%-28s %8s %8s %10s %8s %10s\n", "operation", "irqs", "regs", "bus us", "bus use", "host ns");
+
+  Serial.begin(1000000);
+  bench("Serial.print 13 bytes", serialPrint, UARTE0_UART0_IRQn, 13 * 10000);
+  bench("Serial.write 1000 bytes", serialWrite, UARTE0_UART0_IRQn, 1000 * 10000);
+  bench("Serial.read 64 bytes", serialRead, UARTE0_UART0_IRQn, SERIAL_RX_BUFFER_SIZE * 10000);
+  Serial.end();
+
+  hostSpiDevice(0, spiLoop, NULL);
+  SPI.begin();
+  bench("SPI.transfer 1 byte", spiByte, SPI_IRQ, 1000);
+  bench("SPI.transfer 1024 bytes", spiBlock, SPI_IRQ, 1024 * 1000);
+  SPI.setStreamTimer(NRF_TIMER3);
+  bench("SPI.streamAsync 1024 bytes", spiStream, SPI_IRQ, 1024 * 1000);
+  SPI.setStreamTimer(NULL);
+  SPI.end();
+
+  hostI2cAttach(1, &slave);
+  Wire.begin();
+  Wire.setClock(400000);
+  bench("Wire.writeThenRead 1+6", wireRegister, WIRE_IRQ, (2 + 1 + 6) * 9 * 2500);
+  bench("Wire write 16 bytes", wireWrite, WIRE_IRQ, (1 + 16) * 9 * 2500);
+  bench("Wire.readBuffer 512 bytes", wireRead, WIRE_IRQ, (3 + 512) * 9 * 2500);
+  Wire.end();
+  hostI2cDetach(1);
+
+  return failures;
+}
+
+int main()
+{
+  if (hostRun(run)) {
+    fprintf(stderr, "%d benchmarks failed\n", failures);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,80 @@
+/*
+  Host stand-in for CMSIS core_cm4.h. nrf52.h includes it by name, and the
+  tests directory comes first on the include path. The interrupt masking,
+  NVIC and sleep intrinsics go to the simulator (sim.cpp), which runs the
+  interrupt handlers when the firmware side could be interrupted.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef HOST_CORE_CM4_H
+#define HOST_CORE_CM4_H
+
+// nrf.h includes nrf52.h with uint32_t standing for the register type
+#pragma push_macro("uint32_t")
+#undef uint32_t
+
+#include <stdint.h>
+
+#define __CM4_CMSIS_VERSION_MAIN  0x04
+#define __CM4_CMSIS_VERSION_SUB   0x30
+#define __CORTEX_M                0x04
+
+#define __I     volatile const
+#define __O     volatile
+#define __IO    volatile
+#define __IM    volatile const
+#define __OM    volatile
+#define __IOM   volatile
+
+#define __ASM             __asm__
+#define __INLINE          inline
+#define __STATIC_INLINE   static inline
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void __enable_irq(void);
+void __disable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+uint32_t __get_IPSR(void);
+
+void __WFE(void);
+void __WFI(void);
+void __SEV(void);
+
+#define __NOP() __asm__ volatile ("" ::: "memory")
+#define __ISB() __asm__ volatile ("" ::: "memory")
+#define __DSB() __asm__ volatile ("" ::: "memory")
+#define __DMB() __asm__ volatile ("" ::: "memory")
+
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn);
+void NVIC_SetPendingIRQ(IRQn_Type IRQn);
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn);
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+uint32_t NVIC_GetPriority(IRQn_Type IRQn);
+void NVIC_SystemReset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#pragma pop_macro("uint32_t")
+
+#endif
@@ -0,0 +1,48 @@
+/*
+  Force-included into every host build source. It takes Arduino.h's include
+  guard and declares the little the hardware-independent core sources need
+  from it, so they build without the device headers.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "avr/pgmspace.h"
+#include "itoa.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// newlib has itoa() and utoa(), glibc does not
+char *itoa(int value, char *string, int radix);
+char *utoa(unsigned value, char *string, int radix);
+
+// host/clock.c, or the simulator's clock
+uint32_t millis(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
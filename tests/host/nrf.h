@@ -0,0 +1,232 @@
+/*
+  Host stand-in for the SDK's nrf.h, first on the include path of the host
+  driver builds. It includes the nRF52 device header with uint32_t standing
+  for HostReg, so every register access goes to the simulator, and moves
+  the peripheral base addresses into the simulator's register blocks.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef NRF_H
+#define NRF_H
+
+#ifndef NRF52
+#error "The host build simulates the nRF52 only"
+#endif
+
+#include <stdint.h>
+
+#include "sim.h"
+
+#include "system_nrf52.h"
+
+#define uint32_t HostReg
+#include "nrf52.h"
+#undef uint32_t
+
+#include "nrf52_bitfields.h"
+#include "nrf51_to_nrf52.h"
+#include "nrf52_name_change.h"
+
+#ifndef __WEAK
+#define __WEAK __attribute__((weak))
+#endif
+
+#ifndef __ALIGN
+#define __ALIGN(n) __attribute__((aligned(n)))
+#endif
+
+#undef NRF_FICR_BASE
+#define NRF_FICR_BASE      HOST_BASE(0x10000000UL)
+#undef NRF_UICR_BASE
+#define NRF_UICR_BASE      HOST_BASE(0x10001000UL)
+#undef NRF_BPROT_BASE
+#define NRF_BPROT_BASE     HOST_BASE(0x40000000UL)
+#undef NRF_POWER_BASE
+#define NRF_POWER_BASE     HOST_BASE(0x40000000UL)
+#undef NRF_CLOCK_BASE
+#define NRF_CLOCK_BASE     HOST_BASE(0x40000000UL)
+#undef NRF_AMLI_BASE
+#define NRF_AMLI_BASE      HOST_BASE(0x40000000UL)
+#undef NRF_RADIO_BASE
+#define NRF_RADIO_BASE     HOST_BASE(0x40001000UL)
+#undef NRF_UARTE0_BASE
+#define NRF_UARTE0_BASE    HOST_BASE(0x40002000UL)
+#undef NRF_UART0_BASE
+#define NRF_UART0_BASE     HOST_BASE(0x40002000UL)
+#undef NRF_SPIM0_BASE
+#define NRF_SPIM0_BASE     HOST_BASE(0x40003000UL)
+#undef NRF_SPIS0_BASE
+#define NRF_SPIS0_BASE     HOST_BASE(0x40003000UL)
+#undef NRF_TWIM0_BASE
+#define NRF_TWIM0_BASE     HOST_BASE(0x40003000UL)
+#undef NRF_TWIS0_BASE
+#define NRF_TWIS0_BASE     HOST_BASE(0x40003000UL)
+#undef NRF_SPI0_BASE
+#define NRF_SPI0_BASE      HOST_BASE(0x40003000UL)
+#undef NRF_TWI0_BASE
+#define NRF_TWI0_BASE      HOST_BASE(0x40003000UL)
+#undef NRF_SPIM1_BASE
+#define NRF_SPIM1_BASE     HOST_BASE(0x40004000UL)
+#undef NRF_SPIS1_BASE
+#define NRF_SPIS1_BASE     HOST_BASE(0x40004000UL)
+#undef NRF_TWIM1_BASE
+#define NRF_TWIM1_BASE     HOST_BASE(0x40004000UL)
+#undef NRF_TWIS1_BASE
+#define NRF_TWIS1_BASE     HOST_BASE(0x40004000UL)
+#undef NRF_SPI1_BASE
+#define NRF_SPI1_BASE      HOST_BASE(0x40004000UL)
+#undef NRF_TWI1_BASE
+#define NRF_TWI1_BASE      HOST_BASE(0x40004000UL)
+#undef NRF_NFCT_BASE
+#define NRF_NFCT_BASE      HOST_BASE(0x40005000UL)
+#undef NRF_GPIOTE_BASE
+#define NRF_GPIOTE_BASE    HOST_BASE(0x40006000UL)
+#undef NRF_SAADC_BASE
+#define NRF_SAADC_BASE     HOST_BASE(0x40007000UL)
+#undef NRF_TIMER0_BASE
+#define NRF_TIMER0_BASE    HOST_BASE(0x40008000UL)
+#undef NRF_TIMER1_BASE
+#define NRF_TIMER1_BASE    HOST_BASE(0x40009000UL)
+#undef NRF_TIMER2_BASE
+#define NRF_TIMER2_BASE    HOST_BASE(0x4000A000UL)
+#undef NRF_RTC0_BASE
+#define NRF_RTC0_BASE      HOST_BASE(0x4000B000UL)
+#undef NRF_TEMP_BASE
+#define NRF_TEMP_BASE      HOST_BASE(0x4000C000UL)
+#undef NRF_RNG_BASE
+#define NRF_RNG_BASE       HOST_BASE(0x4000D000UL)
+#undef NRF_ECB_BASE
+#define NRF_ECB_BASE       HOST_BASE(0x4000E000UL)
+#undef NRF_CCM_BASE
+#define NRF_CCM_BASE       HOST_BASE(0x4000F000UL)
+#undef NRF_AAR_BASE
+#define NRF_AAR_BASE       HOST_BASE(0x4000F000UL)
+#undef NRF_WDT_BASE
+#define NRF_WDT_BASE       HOST_BASE(0x40010000UL)
+#undef NRF_RTC1_BASE
+#define NRF_RTC1_BASE      HOST_BASE(0x40011000UL)
+#undef NRF_QDEC_BASE
+#define NRF_QDEC_BASE      HOST_BASE(0x40012000UL)
+#undef NRF_COMP_BASE
+#define NRF_COMP_BASE      HOST_BASE(0x40013000UL)
+#undef NRF_LPCOMP_BASE
+#define NRF_LPCOMP_BASE    HOST_BASE(0x40013000UL)
+#undef NRF_SWI0_BASE
+#define NRF_SWI0_BASE      HOST_BASE(0x40014000UL)
+#undef NRF_EGU0_BASE
+#define NRF_EGU0_BASE      HOST_BASE(0x40014000UL)
+#undef NRF_SWI1_BASE
+#define NRF_SWI1_BASE      HOST_BASE(0x40015000UL)
+#undef NRF_EGU1_BASE
+#define NRF_EGU1_BASE      HOST_BASE(0x40015000UL)
+#undef NRF_SWI2_BASE
+#define NRF_SWI2_BASE      HOST_BASE(0x40016000UL)
+#undef NRF_EGU2_BASE
+#define NRF_EGU2_BASE      HOST_BASE(0x40016000UL)
+#undef NRF_SWI3_BASE
+#define NRF_SWI3_BASE      HOST_BASE(0x40017000UL)
+#undef NRF_EGU3_BASE
+#define NRF_EGU3_BASE      HOST_BASE(0x40017000UL)
+#undef NRF_SWI4_BASE
+#define NRF_SWI4_BASE      HOST_BASE(0x40018000UL)
+#undef NRF_EGU4_BASE
+#define NRF_EGU4_BASE      HOST_BASE(0x40018000UL)
+#undef NRF_SWI5_BASE
+#define NRF_SWI5_BASE      HOST_BASE(0x40019000UL)
+#undef NRF_EGU5_BASE
+#define NRF_EGU5_BASE      HOST_BASE(0x40019000UL)
+#undef NRF_TIMER3_BASE
+#define NRF_TIMER3_BASE    HOST_BASE(0x4001A000UL)
+#undef NRF_TIMER4_BASE
+#define NRF_TIMER4_BASE    HOST_BASE(0x4001B000UL)
+#undef NRF_PWM0_BASE
+#define NRF_PWM0_BASE      HOST_BASE(0x4001C000UL)
+#undef NRF_PDM_BASE
+#define NRF_PDM_BASE       HOST_BASE(0x4001D000UL)
+#undef NRF_NVMC_BASE
+#define NRF_NVMC_BASE      HOST_BASE(0x4001E000UL)
+#undef NRF_PPI_BASE
+#define NRF_PPI_BASE       HOST_BASE(0x4001F000UL)
+#undef NRF_MWU_BASE
+#define NRF_MWU_BASE       HOST_BASE(0x40020000UL)
+#undef NRF_PWM1_BASE
+#define NRF_PWM1_BASE      HOST_BASE(0x40021000UL)
+#undef NRF_PWM2_BASE
+#define NRF_PWM2_BASE      HOST_BASE(0x40022000UL)
+#undef NRF_SPIM2_BASE
+#define NRF_SPIM2_BASE     HOST_BASE(0x40023000UL)
+#undef NRF_SPIS2_BASE
+#define NRF_SPIS2_BASE     HOST_BASE(0x40023000UL)
+#undef NRF_SPI2_BASE
+#define NRF_SPI2_BASE      HOST_BASE(0x40023000UL)
+#undef NRF_RTC2_BASE
+#define NRF_RTC2_BASE      HOST_BASE(0x40024000UL)
+#undef NRF_I2S_BASE
+#define NRF_I2S_BASE       HOST_BASE(0x40025000UL)
+#undef NRF_FPU_BASE
+#define NRF_FPU_BASE       HOST_BASE(0x40026000UL)
+#undef NRF_P0_BASE
+#define NRF_P0_BASE        HOST_BASE(0x50000000UL)
+
+// The vector table. Declared here so that the handlers defined in the core
+// sources built as C++ keep their C names.
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void POWER_CLOCK_IRQHandler(void);
+void RADIO_IRQHandler(void);
+void UARTE0_UART0_IRQHandler(void);
+void SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQHandler(void);
+void SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQHandler(void);
+void NFCT_IRQHandler(void);
+void GPIOTE_IRQHandler(void);
+void SAADC_IRQHandler(void);
+void TIMER0_IRQHandler(void);
+void TIMER1_IRQHandler(void);
+void TIMER2_IRQHandler(void);
+void RTC0_IRQHandler(void);
+void TEMP_IRQHandler(void);
+void RNG_IRQHandler(void);
+void ECB_IRQHandler(void);
+void CCM_AAR_IRQHandler(void);
+void WDT_IRQHandler(void);
+void RTC1_IRQHandler(void);
+void QDEC_IRQHandler(void);
+void COMP_LPCOMP_IRQHandler(void);
+void SWI0_EGU0_IRQHandler(void);
+void SWI1_EGU1_IRQHandler(void);
+void SWI2_EGU2_IRQHandler(void);
+void SWI3_EGU3_IRQHandler(void);
+void SWI4_EGU4_IRQHandler(void);
+void SWI5_EGU5_IRQHandler(void);
+void TIMER3_IRQHandler(void);
+void TIMER4_IRQHandler(void);
+void PWM0_IRQHandler(void);
+void PDM_IRQHandler(void);
+void MWU_IRQHandler(void);
+void PWM1_IRQHandler(void);
+void PWM2_IRQHandler(void);
+void SPIM2_SPIS2_SPI2_IRQHandler(void);
+void RTC2_IRQHandler(void);
+void I2S_IRQHandler(void);
+void FPU_IRQHandler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,35 @@
+/*
+  Host stand-in for the SDK's nrf_delay.h: busy waits let simulated time
+  pass instead of spinning.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _NRF_DELAY_H
+#define _NRF_DELAY_H
+
+#include "nrf.h"
+
+static inline void nrf_delay_us(uint32_t number_of_us)
+{
+  hostIdle((uint64_t)number_of_us * 1000);
+}
+
+static inline void nrf_delay_ms(uint32_t number_of_ms)
+{
+  hostIdle((uint64_t)number_of_ms * 1000000);
+}
+
+#endif
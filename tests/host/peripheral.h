@@ -0,0 +1,103 @@
+/*
+  Internals shared by the simulator core (sim.cpp) and the peripheral
+  models (peripherals.cpp).
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef HOST_PERIPHERAL_H
+#define HOST_PERIPHERAL_H
+
+#include "sim.h"
+
+// Register offsets shared by all peripherals
+#define HOST_EVENTS     0x100
+#define HOST_EVENTS_END 0x200
+#define HOST_INTEN      0x300
+#define HOST_INTENSET   0x304
+#define HOST_INTENCLR   0x308
+
+// A peripheral model, owning one register block. By default an offset
+// below 0x100 is a task, triggered by writing a non-zero value, 0x100 to
+// 0x1FC are the events, INTEN bit n enables the interrupt of the event at
+// 0x100 + 4n, and everything else is plain storage.
+class HostPeripheral
+{
+  public:
+    HostPeripheral(int block);
+    virtual ~HostPeripheral() {}
+
+    // register access by the firmware
+    virtual uint32_t read(uint32_t offset);
+    virtual void write(uint32_t offset, uint32_t value);
+    virtual void task(uint32_t offset) { (void)offset; }
+
+    // Work the hardware has yet to do, done one piece per step(), which
+    // returns the bus time it took
+    virtual bool busy() { return false; }
+    virtual uint64_t step() { return 0; }
+
+    // Timed events: when the next one falls due (UINT64_MAX for none),
+    // and raising those due by now
+    virtual uint64_t nextEvent() { return UINT64_MAX; }
+    virtual void advance() {}
+
+    // sets an event, passes it on through PPI and pends the interrupt
+    void raise(uint32_t offset);
+    // pends the interrupt while an enabled event is set
+    void update();
+    // busy, and its interrupt could be taken straight after a step
+    bool runnable();
+
+    uint32_t &reg(uint32_t offset) { return hostBlocks[block][offset / 4].value; }
+    uint32_t address(uint32_t offset) { return (uint32_t)(uintptr_t)&hostBlocks[block][offset / 4]; }
+
+    int block;
+    uint32_t inten;
+
+  protected:
+    // whether an event goes to PPI, e.g. RTC events only with EVTEN set
+    virtual bool routed(uint32_t offset) { (void)offset; return true; }
+};
+
+extern HostPeripheral *hostModels[HOST_BLOCKS];
+extern uint64_t hostNow;
+
+void hostFault(const char *fmt, ...) __attribute__((noreturn, format(printf, 1, 2)));
+
+// NVIC
+void hostPend(int irq);
+bool hostServiceable(int irq);
+
+// runs the interrupts and the peripheral steps that can go ahead
+void hostSettle(void);
+// lets ns of bus time pass, raising the timed events that fall due
+void hostElapse(uint64_t ns);
+// does the next piece of a peripheral's work, whether or not its
+// interrupt could be taken
+void hostStep(HostPeripheral *p);
+
+// tasks and events by address, as PPI sees them
+void hostTrigger(uint32_t address);
+void hostRoute(uint32_t address);
+bool hostRouted(uint32_t address);
+
+// RAM the firmware handed over as a DMA pointer
+static inline uint8_t *hostMemory(uint32_t address)
+{
+  return (uint8_t *)(uintptr_t)address;
+}
+
+#endif
@@ -0,0 +1,1232 @@
+/*
+  Models of the nRF52 peripherals the core drivers use: GPIO, GPIOTE, PPI,
+  EGU, TIMER, RTC, UARTE and the serial block shared by SPI, SPIM and
+  TWIM. Only what the drivers rely on is modelled; the rest of a register
+  block is plain storage.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stddef.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "nrf.h"
+#include "peripheral.h"
+
+#define OFFSET(type, reg) ((uint32_t)offsetof(NRF_##type##_Type, reg))
+
+// INTEN/EVTEN bit of the event at offset
+#define EVENT_BIT(offset) (1UL << (((offset) - HOST_EVENTS) / 4))
+
+#define UARTE_FIFO_SIZE 6
+#define I2C_SLAVES      4
+
+static uint64_t bitTime(uint64_t hz)
+{
+  return hz ? 1000000000ULL / hz : 1000;
+}
+
+class Gpio : public HostPeripheral
+{
+  public:
+    Gpio() : HostPeripheral(HOST_BLOCK_P0), external(0xFFFFFFFFUL) {}
+
+    uint32_t read(uint32_t offset);
+    void write(uint32_t offset, uint32_t value);
+
+    int level(uint32_t pin);
+
+    uint32_t external;
+};
+
+class Gpiote : public HostPeripheral
+{
+  public:
+    Gpiote() : HostPeripheral(GPIOTE_IRQn) {}
+
+    void write(uint32_t offset, uint32_t value);
+    void task(uint32_t offset);
+
+    // channel driving the pin, -1 for none
+    int owner(uint32_t pin);
+    void pinChanged(uint32_t pin, int level);
+
+    int level[8];
+
+  private:
+    uint32_t config(int ch) { return reg(OFFSET(GPIOTE, CONFIG[0]) + 4 * ch); }
+};
+
+class Ppi : public HostPeripheral
+{
+  public:
+    Ppi() : HostPeripheral(HOST_BLOCK(0x4001F000UL)) {}
+
+    uint32_t read(uint32_t offset);
+    void write(uint32_t offset, uint32_t value);
+    void task(uint32_t offset);
+
+    void route(uint32_t address);
+    bool routed(uint32_t address);
+
+  private:
+    uint32_t &chen() { return reg(OFFSET(PPI, CHEN)); }
+    uint32_t eep(int ch) { return reg(OFFSET(PPI, CH[0].EEP) + 8 * ch); }
+    uint32_t tep(int ch) { return reg(OFFSET(PPI, CH[0].TEP) + 8 * ch); }
+    uint32_t fork(int ch) { return reg(OFFSET(PPI, FORK[0].TEP) + 4 * ch); }
+};
+
+class Egu : public HostPeripheral
+{
+  public:
+    Egu(int irq) : HostPeripheral(irq) {}
+
+    void task(uint32_t offset);
+};
+
+// Counts ticks of simulated time (or COUNT tasks) and raises the compare
+// events. Compares nobody listens to are not looked for.
+class Counter : public HostPeripheral
+{
+  public:
+    Counter(int block, int channels, uint32_t ccOffset, uint32_t compareOffset);
+
+    uint64_t nextEvent();
+    void advance() { sync(); }
+
+  protected:
+    virtual bool ticking() = 0;
+    virtual uint32_t mask() = 0;
+    // ticks = time * rate / scale
+    virtual uint64_t rate() = 0;
+    virtual uint64_t scale() = 0;
+    virtual bool relevant(int n) = 0;
+    virtual void compare(int n) = 0;
+
+    void start();
+    void stop();
+    void sync();
+    void matched();
+
+    uint32_t cc(int n) { return reg(ccOffset + 4 * n) & mask(); }
+    uint64_t nextMatch();
+
+    int channels;
+    uint32_t ccOffset;
+    uint32_t compareOffset;
+
+    bool running;
+    uint64_t startTime;
+    uint64_t seen;
+    uint32_t count;
+};
+
+class Timer : public Counter
+{
+  public:
+    Timer(int block);
+
+    void task(uint32_t offset);
+
+  protected:
+    bool ticking() { return reg(OFFSET(TIMER, MODE)) == TIMER_MODE_MODE_Timer; }
+    uint32_t mask();
+    uint64_t rate() { return 16; }
+    uint64_t scale() { return 1000ULL << (reg(OFFSET(TIMER, PRESCALER)) & 0xF); }
+    bool relevant(int n);
+    void compare(int n);
+};
+
+class Rtc : public Counter
+{
+  public:
+    Rtc(int block);
+
+    uint32_t read(uint32_t offset);
+    void write(uint32_t offset, uint32_t value);
+    void task(uint32_t offset);
+
+  protected:
+    bool ticking() { return true; }
+    uint32_t mask() { return RTC_COUNTER_COUNTER_Msk; }
+    uint64_t rate() { return 32768; }
+    uint64_t scale() { return ((reg(OFFSET(RTC, PRESCALER)) & 0xFFF) + 1) * 1000000000ULL; }
+    bool relevant(int n);
+    void compare(int n) { raise(compareOffset + 4 * n); }
+
+    bool routed(uint32_t offset);
+
+  private:
+    uint32_t evten;
+};
+
+class Uarte : public HostPeripheral
+{
+  public:
+    Uarte() : HostPeripheral(UARTE0_UART0_IRQn), loopback(false), rxOn(false), txOn(false) {}
+
+    void write(uint32_t offset, uint32_t value);
+    void task(uint32_t offset);
+    bool busy();
+    uint64_t step();
+
+    std::deque<uint8_t> line;
+    std::deque<uint8_t> fifo;
+    std::vector<uint8_t> sent;
+    bool loopback;
+
+  private:
+    bool enabled() { return reg(OFFSET(UARTE, ENABLE)) == UARTE_ENABLE_ENABLE_Enabled; }
+    bool rxReady();
+    uint64_t frameTime(size_t bytes);
+
+    void startRx();
+    void endRx();
+    void drain();
+
+    bool rxOn;
+    uint32_t rxPtr;
+    uint32_t rxMax;
+    uint32_t rxCount;
+
+    bool txOn;
+    uint32_t txPtr;
+    uint32_t txMax;
+};
+
+// The serial block of instances 0-2, which is SPI, SPIM or TWIM depending
+// on ENABLE. SPIS and TWIS are not modelled.
+class SerialBox : public HostPeripheral
+{
+  public:
+    SerialBox(int block);
+
+    void write(uint32_t offset, uint32_t value);
+    void task(uint32_t offset);
+    bool busy();
+    uint64_t step();
+
+    HostSpiDevice device;
+    void *deviceArg;
+    HostI2cSlave *slaves[I2C_SLAVES];
+
+  private:
+    enum Phase { Idle, Tx, Rx };
+
+    uint32_t mode() { return reg(OFFSET(SPIM, ENABLE)); }
+    uint8_t exchange(uint8_t mosi) { return device ? device(mosi, deviceArg) : mosi; }
+
+    void spimTask(uint32_t offset);
+    uint64_t spimStep();
+
+    void twimTask(uint32_t offset);
+    uint64_t twimStep();
+    void twimStop();
+    void twimIdle();
+    HostI2cSlave *slave(uint32_t address);
+
+    void reset();
+
+    bool active;
+    bool stopRequest;
+    bool suspendRequest;
+    Phase phase;
+    bool held;
+    bool stuck;
+
+    uint32_t txPtr;
+    uint32_t txMax;
+    uint32_t rxPtr;
+    uint32_t rxMax;
+};
+
+static Gpio gpio;
+static Gpiote gpiote;
+static Ppi ppi;
+static Egu egu0(SWI0_EGU0_IRQn), egu1(SWI1_EGU1_IRQn), egu2(SWI2_EGU2_IRQn);
+static Egu egu3(SWI3_EGU3_IRQn), egu4(SWI4_EGU4_IRQn), egu5(SWI5_EGU5_IRQn);
+static Timer timer0(TIMER0_IRQn), timer1(TIMER1_IRQn), timer2(TIMER2_IRQn);
+static Timer timer3(TIMER3_IRQn), timer4(TIMER4_IRQn);
+static Rtc rtc0(RTC0_IRQn), rtc1(RTC1_IRQn), rtc2(RTC2_IRQn);
+static Uarte uarte;
+static SerialBox serial0(SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn);
+static SerialBox serial1(SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn);
+static SerialBox serial2(SPIM2_SPIS2_SPI2_IRQn);
+
+static SerialBox * const serialBoxes[] = { &serial0, &serial1, &serial2 };
+
+// GPIO
+
+uint32_t Gpio::read(uint32_t offset)
+{
+  if (offset == OFFSET(GPIO, OUTSET) || offset == OFFSET(GPIO, OUTCLR)) {
+    return reg(OFFSET(GPIO, OUT));
+  }
+
+  if (offset == OFFSET(GPIO, DIRSET) || offset == OFFSET(GPIO, DIRCLR)) {
+    return reg(OFFSET(GPIO, DIR));
+  }
+
+  if (offset == OFFSET(GPIO, IN)) {
+    uint32_t in = 0;
+
+    for (uint32_t pin = 0; pin < 32; pin++) {
+      in |= (uint32_t)level(pin) << pin;
+    }
+    return in;
+  }
+
+  if (offset >= OFFSET(GPIO, PIN_CNF[0]) && offset <= OFFSET(GPIO, PIN_CNF[31])) {
+    uint32_t pin = (offset - OFFSET(GPIO, PIN_CNF[0])) / 4;
+
+    return (reg(offset) & ~GPIO_PIN_CNF_DIR_Msk) | ((reg(OFFSET(GPIO, DIR)) >> pin) & 1);
+  }
+
+  return reg(offset);
+}
+
+void Gpio::write(uint32_t offset, uint32_t value)
+{
+  uint32_t &out = reg(OFFSET(GPIO, OUT));
+  uint32_t &dir = reg(OFFSET(GPIO, DIR));
+
+  if (offset == OFFSET(GPIO, OUTSET)) {
+    out |= value;
+  } else if (offset == OFFSET(GPIO, OUTCLR)) {
+    out &= ~value;
+  } else if (offset == OFFSET(GPIO, DIRSET)) {
+    dir |= value;
+  } else if (offset == OFFSET(GPIO, DIRCLR)) {
+    dir &= ~value;
+  } else if (offset >= OFFSET(GPIO, PIN_CNF[0]) && offset <= OFFSET(GPIO, PIN_CNF[31])) {
+    uint32_t pin = (offset - OFFSET(GPIO, PIN_CNF[0])) / 4;
+
+    reg(offset) = value;
+
+    if (value & GPIO_PIN_CNF_DIR_Msk) {
+      dir |= (1UL << pin);
+    } else {
+      dir &= ~(1UL << pin);
+    }
+  } else {
+    reg(offset) = value;
+  }
+}
+
+int Gpio::level(uint32_t pin)
+{
+  int ch = gpiote.owner(pin);
+
+  if (ch >= 0) {
+    return gpiote.level[ch];
+  }
+
+  uint32_t bit = 1UL << pin;
+
+  if (reg(OFFSET(GPIO, DIR)) & bit) {
+    return !!(reg(OFFSET(GPIO, OUT)) & bit);
+  }
+
+  return !!(external & bit);
+}
+
+// GPIOTE
+
+void Gpiote::write(uint32_t offset, uint32_t value)
+{
+  HostPeripheral::write(offset, value);
+
+  if (offset >= OFFSET(GPIOTE, CONFIG[0]) && offset <= OFFSET(GPIOTE, CONFIG[7])) {
+    int ch = (offset - OFFSET(GPIOTE, CONFIG[0])) / 4;
+
+    level[ch] = (value >> GPIOTE_CONFIG_OUTINIT_Pos) & 1;
+  }
+}
+
+void Gpiote::task(uint32_t offset)
+{
+  int ch = (offset % 0x30) / 4;
+
+  if (ch >= 8 || ((config(ch) & GPIOTE_CONFIG_MODE_Msk) >> GPIOTE_CONFIG_MODE_Pos) != GPIOTE_CONFIG_MODE_Task) {
+    return;
+  }
+
+  if (offset < OFFSET(GPIOTE, TASKS_SET[0])) {
+    switch ((config(ch) & GPIOTE_CONFIG_POLARITY_Msk) >> GPIOTE_CONFIG_POLARITY_Pos) {
+      case GPIOTE_CONFIG_POLARITY_LoToHi: level[ch] = 1; break;
+      case GPIOTE_CONFIG_POLARITY_HiToLo: level[ch] = 0; break;
+      case GPIOTE_CONFIG_POLARITY_Toggle: level[ch] ^= 1; break;
+    }
+  } else if (offset < OFFSET(GPIOTE, TASKS_CLR[0])) {
+    level[ch] = 1;
+  } else {
+    level[ch] = 0;
+  }
+}
+
+int Gpiote::owner(uint32_t pin)
+{
+  for (int ch = 0; ch < 8; ch++) {
+    uint32_t c = config(ch);
+
+    if (((c & GPIOTE_CONFIG_MODE_Msk) >> GPIOTE_CONFIG_MODE_Pos) == GPIOTE_CONFIG_MODE_Task
+        && ((c & GPIOTE_CONFIG_PSEL_Msk) >> GPIOTE_CONFIG_PSEL_Pos) == pin) {
+      return ch;
+    }
+  }
+
+  return -1;
+}
+
+void Gpiote::pinChanged(uint32_t pin, int level)
+{
+  for (int ch = 0; ch < 8; ch++) {
+    uint32_t c = config(ch);
+
+    if (((c & GPIOTE_CONFIG_MODE_Msk) >> GPIOTE_CONFIG_MODE_Pos) != GPIOTE_CONFIG_MODE_Event
+        || ((c & GPIOTE_CONFIG_PSEL_Msk) >> GPIOTE_CONFIG_PSEL_Pos) != pin) {
+      continue;
+    }
+
+    uint32_t polarity = (c & GPIOTE_CONFIG_POLARITY_Msk) >> GPIOTE_CONFIG_POLARITY_Pos;
+
+    if (polarity == GPIOTE_CONFIG_POLARITY_Toggle
+        || (polarity == GPIOTE_CONFIG_POLARITY_LoToHi && level)
+        || (polarity == GPIOTE_CONFIG_POLARITY_HiToLo && !level)) {
+      raise(OFFSET(GPIOTE, EVENTS_IN[0]) + 4 * ch);
+    }
+  }
+}
+
+// PPI
+
+uint32_t Ppi::read(uint32_t offset)
+{
+  if (offset == OFFSET(PPI, CHENSET) || offset == OFFSET(PPI, CHENCLR)) {
+    return chen();
+  }
+
+  return reg(offset);
+}
+
+void Ppi::write(uint32_t offset, uint32_t value)
+{
+  if (offset == OFFSET(PPI, CHENSET)) {
+    chen() |= value;
+  } else if (offset == OFFSET(PPI, CHENCLR)) {
+    chen() &= ~value;
+  } else {
+    HostPeripheral::write(offset, value);
+  }
+}
+
+void Ppi::task(uint32_t offset)
+{
+  int group = offset / 8;
+  uint32_t chg = reg(OFFSET(PPI, CHG[0]) + 4 * group);
+
+  if (offset % 8 == 0) {
+    chen() |= chg;
+  } else {
+    chen() &= ~chg;
+  }
+}
+
+void Ppi::route(uint32_t address)
+{
+  // the channels the event goes through are those enabled when it happens
+  int matched[20];
+  int count = 0;
+
+  for (int ch = 0; ch < 20; ch++) {
+    if ((chen() & (1UL << ch)) && eep(ch) == address) {
+      matched[count++] = ch;
+    }
+  }
+
+  for (int i = 0; i < count; i++) {
+    hostTrigger(tep(matched[i]));
+    hostTrigger(fork(matched[i]));
+  }
+}
+
+bool Ppi::routed(uint32_t address)
+{
+  for (int ch = 0; ch < 20; ch++) {
+    if ((chen() & (1UL << ch)) && eep(ch) == address) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void hostRoute(uint32_t address)
+{
+  ppi.route(address);
+}
+
+bool hostRouted(uint32_t address)
+{
+  return ppi.routed(address);
+}
+
+// EGU
+
+void Egu::task(uint32_t offset)
+{
+  if (offset <= OFFSET(EGU, TASKS_TRIGGER[15])) {
+    raise(OFFSET(EGU, EVENTS_TRIGGERED[0]) + offset);
+  }
+}
+
+// TIMER and RTC
+
+Counter::Counter(int block, int channels, uint32_t ccOffset, uint32_t compareOffset) :
+  HostPeripheral(block),
+  channels(channels),
+  ccOffset(ccOffset),
+  compareOffset(compareOffset),
+  running(false),
+  startTime(0),
+  seen(0),
+  count(0)
+{
+}
+
+void Counter::start()
+{
+  if (!running) {
+    running = true;
+    startTime = hostNow;
+    seen = 0;
+  }
+}
+
+void Counter::stop()
+{
+  sync();
+  running = false;
+}
+
+// the tick after seen at which a compare listened to matches next
+uint64_t Counter::nextMatch()
+{
+  uint64_t next = UINT64_MAX;
+
+  for (int n = 0; n < channels; n++) {
+    if (relevant(n)) {
+      uint64_t k = seen + 1 + ((cc(n) - count - 1) & mask());
+
+      if (k < next) {
+        next = k;
+      }
+    }
+  }
+
+  return next;
+}
+
+uint64_t Counter::nextEvent()
+{
+  if (!running || !ticking()) {
+    return UINT64_MAX;
+  }
+
+  uint64_t k = nextMatch();
+
+  if (k == UINT64_MAX) {
+    return UINT64_MAX;
+  }
+
+  return startTime + (uint64_t)(((unsigned __int128)k * scale() + rate() - 1) / rate());
+}
+
+// Counts the ticks up to now, raising the compares on the way
+void Counter::sync()
+{
+  if (!running || !ticking()) {
+    return;
+  }
+
+  uint64_t now = (uint64_t)(((unsigned __int128)(hostNow - startTime) * rate()) / scale());
+
+  while (running && seen < now) {
+    uint64_t k = nextMatch();
+
+    if (k > now) {
+      count = (count + (now - seen)) & mask();
+      seen = now;
+      break;
+    }
+
+    count = (count + (k - seen)) & mask();
+    seen = k;
+
+    matched();
+  }
+}
+
+void Counter::matched()
+{
+  bool hit[8];
+
+  // a compare can clear the counter, so all are looked at first
+  for (int n = 0; n < channels; n++) {
+    hit[n] = relevant(n) && cc(n) == count;
+  }
+
+  for (int n = 0; n < channels; n++) {
+    if (hit[n]) {
+      compare(n);
+    }
+  }
+}
+
+Timer::Timer(int block) :
+  Counter(block, 6, OFFSET(TIMER, CC[0]), OFFSET(TIMER, EVENTS_COMPARE[0]))
+{
+}
+
+uint32_t Timer::mask()
+{
+  switch (reg(OFFSET(TIMER, BITMODE)) & TIMER_BITMODE_BITMODE_Msk) {
+    case TIMER_BITMODE_BITMODE_08Bit: return 0xFFUL;
+    case TIMER_BITMODE_BITMODE_24Bit: return 0xFFFFFFUL;
+    case TIMER_BITMODE_BITMODE_32Bit: return 0xFFFFFFFFUL;
+    default: return 0xFFFFUL;
+  }
+}
+
+bool Timer::relevant(int n)
+{
+  uint32_t shorts = reg(OFFSET(TIMER, SHORTS));
+  uint32_t offset = compareOffset + 4 * n;
+
+  return (inten & EVENT_BIT(offset))
+      || (shorts & ((TIMER_SHORTS_COMPARE0_CLEAR_Msk | TIMER_SHORTS_COMPARE0_STOP_Msk) << n))
+      || hostRouted(address(offset));
+}
+
+void Timer::compare(int n)
+{
+  uint32_t shorts = reg(OFFSET(TIMER, SHORTS));
+
+  raise(compareOffset + 4 * n);
+
+  if (shorts & (TIMER_SHORTS_COMPARE0_CLEAR_Msk << n)) {
+    count = 0;
+  }
+  if (shorts & (TIMER_SHORTS_COMPARE0_STOP_Msk << n)) {
+    running = false;
+  }
+}
+
+void Timer::task(uint32_t offset)
+{
+  if (offset == OFFSET(TIMER, TASKS_START)) {
+    start();
+  } else if (offset == OFFSET(TIMER, TASKS_STOP)) {
+    stop();
+  } else if (offset == OFFSET(TIMER, TASKS_SHUTDOWN)) {
+    stop();
+    count = 0;
+  } else if (offset == OFFSET(TIMER, TASKS_CLEAR)) {
+    sync();
+    count = 0;
+  } else if (offset == OFFSET(TIMER, TASKS_COUNT)) {
+    if (running && !ticking()) {
+      count = (count + 1) & mask();
+
+      for (int n = 0; n < channels; n++) {
+        if (cc(n) == count) {
+          compare(n);
+        }
+      }
+    }
+  } else if (offset >= OFFSET(TIMER, TASKS_CAPTURE[0]) && offset <= OFFSET(TIMER, TASKS_CAPTURE[5])) {
+    sync();
+    reg(ccOffset + offset - OFFSET(TIMER, TASKS_CAPTURE[0])) = count;
+  }
+}
+
+Rtc::Rtc(int block) :
+  Counter(block, 4, OFFSET(RTC, CC[0]), OFFSET(RTC, EVENTS_COMPARE[0])),
+  evten(0)
+{
+}
+
+uint32_t Rtc::read(uint32_t offset)
+{
+  if (offset == OFFSET(RTC, COUNTER)) {
+    sync();
+    return count;
+  }
+
+  if (offset == OFFSET(RTC, EVTEN) || offset == OFFSET(RTC, EVTENSET) || offset == OFFSET(RTC, EVTENCLR)) {
+    return evten;
+  }
+
+  return HostPeripheral::read(offset);
+}
+
+void Rtc::write(uint32_t offset, uint32_t value)
+{
+  // compares are looked for from the counter as it is now
+  sync();
+
+  if (offset == OFFSET(RTC, EVTEN)) {
+    evten = value;
+  } else if (offset == OFFSET(RTC, EVTENSET)) {
+    evten |= value;
+  } else if (offset == OFFSET(RTC, EVTENCLR)) {
+    evten &= ~value;
+  } else {
+    HostPeripheral::write(offset, value);
+  }
+}
+
+void Rtc::task(uint32_t offset)
+{
+  if (offset == OFFSET(RTC, TASKS_START)) {
+    start();
+  } else if (offset == OFFSET(RTC, TASKS_STOP)) {
+    stop();
+  } else if (offset == OFFSET(RTC, TASKS_CLEAR)) {
+    sync();
+    count = 0;
+  } else if (offset == OFFSET(RTC, TASKS_TRIGOVRFLW)) {
+    sync();
+    count = 0xFFFFF0;
+  }
+}
+
+bool Rtc::relevant(int n)
+{
+  return (inten | evten) & EVENT_BIT(compareOffset + 4 * n);
+}
+
+bool Rtc::routed(uint32_t offset)
+{
+  return evten & EVENT_BIT(offset);
+}
+
+// UARTE
+
+void Uarte::write(uint32_t offset, uint32_t value)
+{
+  if (offset == OFFSET(UARTE, ERRORSRC)) {
+    // write one to clear
+    reg(offset) &= ~value;
+    return;
+  }
+
+  HostPeripheral::write(offset, value);
+
+  if (offset == OFFSET(UARTE, ENABLE) && !enabled()) {
+    rxOn = false;
+    txOn = false;
+    fifo.clear();
+  }
+}
+
+uint64_t Uarte::frameTime(size_t bytes)
+{
+  // BAUDRATE is the increment of a 32 bit accumulator clocked at 16 MHz
+  uint64_t baud = ((uint64_t)reg(OFFSET(UARTE, BAUDRATE)) * 16000000ULL) >> 32;
+
+  return bytes * 10 * bitTime(baud);
+}
+
+// With flow control RTS holds the sender off once the FIFO is full
+bool Uarte::rxReady()
+{
+  bool hwfc = reg(OFFSET(UARTE, CONFIG)) & UARTE_CONFIG_HWFC_Msk;
+
+  return !line.empty() && (!hwfc || fifo.size() < UARTE_FIFO_SIZE);
+}
+
+bool Uarte::busy()
+{
+  return enabled() && (txOn || rxReady());
+}
+
+uint64_t Uarte::step()
+{
+  if (txOn) {
+    uint8_t *tx = hostMemory(txPtr);
+
+    sent.insert(sent.end(), tx, tx + txMax);
+
+    if (loopback) {
+      line.insert(line.end(), tx, tx + txMax);
+    }
+
+    txOn = false;
+    reg(OFFSET(UARTE, TXD.AMOUNT)) = txMax;
+    raise(OFFSET(UARTE, EVENTS_ENDTX));
+
+    return frameTime(txMax);
+  }
+
+  uint8_t c = line.front();
+  line.pop_front();
+
+  if (fifo.size() < UARTE_FIFO_SIZE) {
+    fifo.push_back(c);
+
+    // RXDRDY is not in NRF_UARTE_Type, but sits at the same offset as in UART
+    raise(OFFSET(UART, EVENTS_RXDRDY));
+  } else {
+    reg(OFFSET(UARTE, ERRORSRC)) |= UARTE_ERRORSRC_OVERRUN_Msk;
+    raise(OFFSET(UARTE, EVENTS_ERROR));
+  }
+
+  drain();
+
+  return frameTime(1);
+}
+
+void Uarte::startRx()
+{
+  rxPtr = reg(OFFSET(UARTE, RXD.PTR));
+  rxMax = reg(OFFSET(UARTE, RXD.MAXCNT));
+  rxCount = 0;
+  rxOn = true;
+
+  raise(OFFSET(UARTE, EVENTS_RXSTARTED));
+
+  drain();
+}
+
+void Uarte::endRx()
+{
+  rxOn = false;
+  reg(OFFSET(UARTE, RXD.AMOUNT)) = rxCount;
+
+  raise(OFFSET(UARTE, EVENTS_ENDRX));
+
+  // an empty buffer would end straight away again
+  if ((reg(OFFSET(UARTE, SHORTS)) & UARTE_SHORTS_ENDRX_STARTRX_Msk) && rxMax) {
+    startRx();
+  }
+}
+
+// EasyDMA moves what is in the FIFO to RAM while a buffer is set up
+void Uarte::drain()
+{
+  while (rxOn && rxCount < rxMax && !fifo.empty()) {
+    hostMemory(rxPtr)[rxCount++] = fifo.front();
+    fifo.pop_front();
+  }
+
+  if (rxOn && rxCount == rxMax) {
+    endRx();
+  }
+}
+
+void Uarte::task(uint32_t offset)
+{
+  if (!enabled()) {
+    return;
+  }
+
+  if (offset == OFFSET(UARTE, TASKS_STARTRX)) {
+    startRx();
+  } else if (offset == OFFSET(UARTE, TASKS_STOPRX)) {
+    if (rxOn) {
+      endRx();
+    }
+    raise(OFFSET(UARTE, EVENTS_RXTO));
+  } else if (offset == OFFSET(UARTE, TASKS_STARTTX)) {
+    txPtr = reg(OFFSET(UARTE, TXD.PTR));
+    txMax = reg(OFFSET(UARTE, TXD.MAXCNT));
+    txOn = true;
+
+    raise(OFFSET(UARTE, EVENTS_TXSTARTED));
+  } else if (offset == OFFSET(UARTE, TASKS_STOPTX)) {
+    if (txOn) {
+      txOn = false;
+      reg(OFFSET(UARTE, TXD.AMOUNT)) = 0;
+    }
+    raise(OFFSET(UARTE, EVENTS_TXSTOPPED));
+  }
+}
+
+// SPI, SPIM and TWIM
+
+SerialBox::SerialBox(int block) :
+  HostPeripheral(block),
+  device(NULL),
+  deviceArg(NULL)
+{
+  for (int i = 0; i < I2C_SLAVES; i++) {
+    slaves[i] = NULL;
+  }
+
+  reset();
+}
+
+void SerialBox::reset()
+{
+  active = false;
+  stopRequest = false;
+  suspendRequest = false;
+  phase = Idle;
+  held = false;
+  stuck = false;
+}
+
+void SerialBox::write(uint32_t offset, uint32_t value)
+{
+  if (offset == OFFSET(TWIM, ERRORSRC)) {
+    reg(offset) &= ~value;
+    return;
+  }
+
+  if (offset == OFFSET(SPI, TXD) && mode() == SPI_ENABLE_ENABLE_Enabled) {
+    // the legacy SPI has no DMA: the byte is exchanged while the CPU waits
+    reg(OFFSET(SPI, RXD)) = exchange(value);
+    hostElapse(8 * bitTime((reg(OFFSET(SPI, FREQUENCY)) >> 25) * 125000ULL));
+    raise(OFFSET(SPI, EVENTS_READY));
+    return;
+  }
+
+  HostPeripheral::write(offset, value);
+
+  if (offset == OFFSET(SPIM, ENABLE) && !value) {
+    reset();
+  }
+}
+
+void SerialBox::task(uint32_t offset)
+{
+  if (mode() == SPIM_ENABLE_ENABLE_Enabled) {
+    spimTask(offset);
+  } else if (mode() == TWIM_ENABLE_ENABLE_Enabled) {
+    twimTask(offset);
+  }
+}
+
+bool SerialBox::busy()
+{
+  if (mode() == SPIM_ENABLE_ENABLE_Enabled) {
+    return active;
+  }
+
+  if (mode() == TWIM_ENABLE_ENABLE_Enabled) {
+    return phase != Idle && !stuck;
+  }
+
+  return false;
+}
+
+uint64_t SerialBox::step()
+{
+  return (mode() == SPIM_ENABLE_ENABLE_Enabled) ? spimStep() : twimStep();
+}
+
+void SerialBox::spimTask(uint32_t offset)
+{
+  if (offset == OFFSET(SPIM, TASKS_START)) {
+    if (active) {
+      return;
+    }
+
+    txPtr = reg(OFFSET(SPIM, TXD.PTR));
+    txMax = reg(OFFSET(SPIM, TXD.MAXCNT));
+    rxPtr = reg(OFFSET(SPIM, RXD.PTR));
+    rxMax = reg(OFFSET(SPIM, RXD.MAXCNT));
+    active = true;
+
+    raise(OFFSET(SPIM, EVENTS_STARTED));
+  } else if (offset == OFFSET(SPIM, TASKS_STOP)) {
+    if (active) {
+      stopRequest = true;
+    } else {
+      raise(OFFSET(SPIM, EVENTS_STOPPED));
+    }
+  }
+}
+
+uint64_t SerialBox::spimStep()
+{
+  uint32_t n = (txMax > rxMax) ? txMax : rxMax;
+  uint8_t *tx = hostMemory(txPtr);
+  uint8_t *rx = hostMemory(rxPtr);
+  uint8_t orc = reg(OFFSET(SPIM, ORC));
+
+  for (uint32_t i = 0; i < n; i++) {
+    uint8_t miso = exchange((i < txMax) ? tx[i] : orc);
+
+    if (i < rxMax) {
+      rx[i] = miso;
+    }
+  }
+
+  reg(OFFSET(SPIM, TXD.AMOUNT)) = txMax;
+  reg(OFFSET(SPIM, RXD.AMOUNT)) = rxMax;
+
+  // the array list moves the pointer on to the next buffer
+  if (reg(OFFSET(SPIM, TXD.LIST)) == SPIM_TXD_LIST_LIST_ArrayList) {
+    reg(OFFSET(SPIM, TXD.PTR)) += txMax;
+  }
+  if (reg(OFFSET(SPIM, RXD.LIST)) == SPIM_RXD_LIST_LIST_ArrayList) {
+    reg(OFFSET(SPIM, RXD.PTR)) += rxMax;
+  }
+
+  active = false;
+
+  raise(OFFSET(SPIM, EVENTS_ENDTX));
+  raise(OFFSET(SPIM, EVENTS_ENDRX));
+  raise(OFFSET(SPIM, EVENTS_END));
+
+  if (stopRequest) {
+    stopRequest = false;
+    raise(OFFSET(SPIM, EVENTS_STOPPED));
+  } else if (reg(OFFSET(SPIM, SHORTS)) & SPIM_SHORTS_END_START_Msk) {
+    spimTask(OFFSET(SPIM, TASKS_START));
+  }
+
+  // FREQUENCY counts in steps of 125 kHz from bit 25
+  return n * 8 * bitTime((reg(OFFSET(SPIM, FREQUENCY)) >> 25) * 125000ULL);
+}
+
+HostI2cSlave *SerialBox::slave(uint32_t address)
+{
+  for (int i = 0; i < I2C_SLAVES; i++) {
+    if (slaves[i] && slaves[i]->address == address) {
+      return slaves[i];
+    }
+  }
+
+  return NULL;
+}
+
+void SerialBox::twimTask(uint32_t offset)
+{
+  if (offset == OFFSET(TWIM, TASKS_STARTTX)) {
+    txPtr = reg(OFFSET(TWIM, TXD.PTR));
+    txMax = reg(OFFSET(TWIM, TXD.MAXCNT));
+    phase = Tx;
+
+    raise(OFFSET(TWIM, EVENTS_TXSTARTED));
+  } else if (offset == OFFSET(TWIM, TASKS_STARTRX)) {
+    rxPtr = reg(OFFSET(TWIM, RXD.PTR));
+    rxMax = reg(OFFSET(TWIM, RXD.MAXCNT));
+    phase = Rx;
+
+    raise(OFFSET(TWIM, EVENTS_RXSTARTED));
+  } else if (offset == OFFSET(TWIM, TASKS_STOP)) {
+    if (stuck) {
+      // SCL is held low, so the STOP cannot go out
+    } else if (phase != Idle) {
+      stopRequest = true;
+    } else if (held) {
+      twimStop();
+    }
+  } else if (offset == OFFSET(TWIM, TASKS_SUSPEND)) {
+    if (phase != Idle) {
+      suspendRequest = true;
+    } else if (held) {
+      raise(OFFSET(TWIM, EVENTS_SUSPENDED));
+    }
+  }
+}
+
+void SerialBox::twimStop()
+{
+  phase = Idle;
+  held = false;
+  stopRequest = false;
+  suspendRequest = false;
+
+  raise(OFFSET(TWIM, EVENTS_STOPPED));
+}
+
+// a STOP or SUSPEND asked for during the transfer takes effect once the
+// bus is idle
+void SerialBox::twimIdle()
+{
+  if (phase != Idle) {
+    return;
+  }
+
+  if (stopRequest) {
+    twimStop();
+  } else if (suspendRequest) {
+    suspendRequest = false;
+    raise(OFFSET(TWIM, EVENTS_SUSPENDED));
+  }
+}
+
+uint64_t SerialBox::twimStep()
+{
+  uint32_t frequency = reg(OFFSET(TWIM, FREQUENCY));
+  // K100 is 0x01980000
+  uint64_t bit = bitTime(frequency ? ((uint64_t)(frequency >> 16) * 100000) / 0x198 : 100000);
+  HostI2cSlave *s = slave(reg(OFFSET(TWIM, ADDRESS)));
+  uint32_t shorts = reg(OFFSET(TWIM, SHORTS));
+
+  held = true;
+
+  if (s && s->stretch) {
+    stuck = true;
+    return 9 * bit;
+  }
+
+  Phase done = phase;
+  phase = Idle;
+
+  if (!s) {
+    reg((done == Tx) ? OFFSET(TWIM, TXD.AMOUNT) : OFFSET(TWIM, RXD.AMOUNT)) = 0;
+    reg(OFFSET(TWIM, ERRORSRC)) |= TWIM_ERRORSRC_ANACK_Msk;
+    raise(OFFSET(TWIM, EVENTS_ERROR));
+
+    twimIdle();
+    return 9 * bit;
+  }
+
+  s->transfers++;
+
+  uint32_t n;
+
+  if (done == Tx) {
+    uint8_t *tx = hostMemory(txPtr);
+
+    n = txMax;
+
+    // the first byte written selects the register
+    for (uint32_t i = 0; i < n; i++) {
+      if (i == 0) {
+        s->pointer = tx[i];
+      } else {
+        s->regs[s->pointer++] = tx[i];
+      }
+    }
+
+    reg(OFFSET(TWIM, TXD.AMOUNT)) = n;
+
+    if (n) {
+      raise(OFFSET(TWIM, EVENTS_LASTTX));
+
+      if (shorts & TWIM_SHORTS_LASTTX_STARTRX_Msk) {
+        twimTask(OFFSET(TWIM, TASKS_STARTRX));
+      } else if (shorts & TWIM_SHORTS_LASTTX_SUSPEND_Msk) {
+        suspendRequest = true;
+      } else if (shorts & TWIM_SHORTS_LASTTX_STOP_Msk) {
+        stopRequest = true;
+      }
+    }
+  } else {
+    uint8_t *rx = hostMemory(rxPtr);
+
+    n = rxMax;
+
+    for (uint32_t i = 0; i < n; i++) {
+      rx[i] = s->regs[s->pointer++];
+    }
+
+    reg(OFFSET(TWIM, RXD.AMOUNT)) = n;
+
+    // a chained read restarts through PPI from here
+    raise(OFFSET(TWIM, EVENTS_LASTRX));
+
+    if (shorts & TWIM_SHORTS_LASTRX_STOP_Msk) {
+      stopRequest = true;
+    } else if (shorts & TWIM_SHORTS_LASTRX_STARTTX_Msk) {
+      twimTask(OFFSET(TWIM, TASKS_STARTTX));
+    }
+  }
+
+  twimIdle();
+
+  return (n + 1) * 9 * bit;
+}
+
+// Test side
+
+void hostPinLevel(uint32_t pin, int level)
+{
+  int was = gpio.level(pin);
+
+  if (level) {
+    gpio.external |= (1UL << pin);
+  } else {
+    gpio.external &= ~(1UL << pin);
+  }
+
+  if (gpio.level(pin) != was) {
+    gpiote.pinChanged(pin, level);
+  }
+
+  hostSettle();
+}
+
+int hostPinRead(uint32_t pin)
+{
+  return gpio.level(pin);
+}
+
+void hostUartReceive(const uint8_t *data, size_t size)
+{
+  uarte.line.insert(uarte.line.end(), data, data + size);
+
+  hostSettle();
+}
+
+size_t hostUartSent(uint8_t *data, size_t size)
+{
+  if (size > uarte.sent.size()) {
+    size = uarte.sent.size();
+  }
+
+  std::copy(uarte.sent.begin(), uarte.sent.begin() + size, data);
+  uarte.sent.erase(uarte.sent.begin(), uarte.sent.begin() + size);
+
+  return size;
+}
+
+void hostUartLoopback(int on)
+{
+  uarte.loopback = on;
+}
+
+void hostSpiDevice(int instance, HostSpiDevice device, void *arg)
+{
+  serialBoxes[instance]->device = device;
+  serialBoxes[instance]->deviceArg = arg;
+}
+
+void hostI2cAttach(int instance, HostI2cSlave *slave)
+{
+  for (int i = 0; i < I2C_SLAVES; i++) {
+    if (!serialBoxes[instance]->slaves[i]) {
+      serialBoxes[instance]->slaves[i] = slave;
+      return;
+    }
+  }
+
+  hostFault("too many I2C slaves on TWIM%d", instance);
+}
+
+void hostI2cDetach(int instance)
+{
+  for (int i = 0; i < I2C_SLAVES; i++) {
+    serialBoxes[instance]->slaves[i] = NULL;
+  }
+}
@@ -0,0 +1,726 @@
+/*
+  Simulator core: register access, the NVIC, interrupt dispatch and the
+  simulated clock.
+
+  There is no hardware thread. A peripheral with work to do is stepped
+  whenever its interrupt could be taken right after (thread mode, or a
+  handler of lower priority, with PRIMASK clear), so the handlers see the
+  events in the order the hardware raises them. Firmware waiting with the
+  interrupt masked polls an event register or sleeps in __WFE(), and
+  either one moves the hardware on regardless.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "nrf.h"
+#include "delay.h"
+#include "peripheral.h"
+
+#define HOST_IRQS 39
+
+// thread mode runs below every interrupt priority
+#define THREAD_PRIORITY 256
+
+// handler entries without time passing before the interrupt is called stuck
+#define STORM_LIMIT 1000000
+
+HostReg hostBlocks[HOST_BLOCKS][1024] __attribute__((aligned(4096)));
+HostPeripheral *hostModels[HOST_BLOCKS];
+uint64_t hostNow;
+
+uint32_t SystemCoreClock = 64000000;
+
+static bool irqEnabled[HOST_IRQS];
+static bool irqPending[HOST_IRQS];
+static uint8_t irqPriority[HOST_IRQS];
+static uint32_t irqCount[HOST_IRQS];
+
+static uint32_t primask;
+static int execPriority = THREAD_PRIORITY;
+static uint32_t ipsr;
+
+// the event register of WFE/SEV
+static bool wakeEvent;
+
+static uint32_t storm;
+
+// Weak references, like the startup code's default handlers: an interrupt
+// without a handler is a fault
+#define VECTOR(name) extern "C" void name(void) __attribute__((weak));
+VECTOR(POWER_CLOCK_IRQHandler)
+VECTOR(RADIO_IRQHandler)
+VECTOR(UARTE0_UART0_IRQHandler)
+VECTOR(SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQHandler)
+VECTOR(SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQHandler)
+VECTOR(NFCT_IRQHandler)
+VECTOR(GPIOTE_IRQHandler)
+VECTOR(SAADC_IRQHandler)
+VECTOR(TIMER0_IRQHandler)
+VECTOR(TIMER1_IRQHandler)
+VECTOR(TIMER2_IRQHandler)
+VECTOR(RTC0_IRQHandler)
+VECTOR(TEMP_IRQHandler)
+VECTOR(RNG_IRQHandler)
+VECTOR(ECB_IRQHandler)
+VECTOR(CCM_AAR_IRQHandler)
+VECTOR(WDT_IRQHandler)
+VECTOR(RTC1_IRQHandler)
+VECTOR(QDEC_IRQHandler)
+VECTOR(COMP_LPCOMP_IRQHandler)
+VECTOR(SWI0_EGU0_IRQHandler)
+VECTOR(SWI1_EGU1_IRQHandler)
+VECTOR(SWI2_EGU2_IRQHandler)
+VECTOR(SWI3_EGU3_IRQHandler)
+VECTOR(SWI4_EGU4_IRQHandler)
+VECTOR(SWI5_EGU5_IRQHandler)
+VECTOR(TIMER3_IRQHandler)
+VECTOR(TIMER4_IRQHandler)
+VECTOR(PWM0_IRQHandler)
+VECTOR(PDM_IRQHandler)
+VECTOR(MWU_IRQHandler)
+VECTOR(PWM1_IRQHandler)
+VECTOR(PWM2_IRQHandler)
+VECTOR(SPIM2_SPIS2_SPI2_IRQHandler)
+VECTOR(RTC2_IRQHandler)
+VECTOR(I2S_IRQHandler)
+VECTOR(FPU_IRQHandler)
+
+static void (* const vectors[HOST_IRQS])(void) = {
+  POWER_CLOCK_IRQHandler,
+  RADIO_IRQHandler,
+  UARTE0_UART0_IRQHandler,
+  SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQHandler,
+  SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQHandler,
+  NFCT_IRQHandler,
+  GPIOTE_IRQHandler,
+  SAADC_IRQHandler,
+  TIMER0_IRQHandler,
+  TIMER1_IRQHandler,
+  TIMER2_IRQHandler,
+  RTC0_IRQHandler,
+  TEMP_IRQHandler,
+  RNG_IRQHandler,
+  ECB_IRQHandler,
+  CCM_AAR_IRQHandler,
+  WDT_IRQHandler,
+  RTC1_IRQHandler,
+  QDEC_IRQHandler,
+  COMP_LPCOMP_IRQHandler,
+  SWI0_EGU0_IRQHandler,
+  SWI1_EGU1_IRQHandler,
+  SWI2_EGU2_IRQHandler,
+  SWI3_EGU3_IRQHandler,
+  SWI4_EGU4_IRQHandler,
+  SWI5_EGU5_IRQHandler,
+  TIMER3_IRQHandler,
+  TIMER4_IRQHandler,
+  PWM0_IRQHandler,
+  PDM_IRQHandler,
+  NULL,
+  NULL,
+  MWU_IRQHandler,
+  PWM1_IRQHandler,
+  PWM2_IRQHandler,
+  SPIM2_SPIS2_SPI2_IRQHandler,
+  RTC2_IRQHandler,
+  I2S_IRQHandler,
+  FPU_IRQHandler,
+};
+
+void hostFault(const char *fmt, ...)
+{
+  va_list args;
+
+  va_start(args, fmt);
+  fprintf(stderr, "sim fault at %llu ns: ", (unsigned long long)hostNow);
+  vfprintf(stderr, fmt, args);
+  fprintf(stderr, "\n");
+  va_end(args);
+
+  abort();
+}
+
+HostPeripheral::HostPeripheral(int block) :
+  block(block),
+  inten(0)
+{
+  hostModels[block] = this;
+}
+
+uint32_t HostPeripheral::read(uint32_t offset)
+{
+  if (offset == HOST_INTEN || offset == HOST_INTENSET || offset == HOST_INTENCLR) {
+    return inten;
+  }
+
+  return reg(offset);
+}
+
+void HostPeripheral::write(uint32_t offset, uint32_t value)
+{
+  if (offset < HOST_EVENTS) {
+    if (value) {
+      task(offset);
+    }
+  } else if (offset < HOST_EVENTS_END) {
+    reg(offset) = value;
+  } else if (offset == HOST_INTEN) {
+    inten = value;
+  } else if (offset == HOST_INTENSET) {
+    inten |= value;
+  } else if (offset == HOST_INTENCLR) {
+    inten &= ~value;
+  } else {
+    reg(offset) = value;
+  }
+
+  update();
+}
+
+void HostPeripheral::raise(uint32_t offset)
+{
+  reg(offset) = 1;
+
+  if (routed(offset)) {
+    hostRoute(address(offset));
+  }
+
+  update();
+}
+
+void HostPeripheral::update()
+{
+  if (block >= HOST_IRQS) {
+    return;
+  }
+
+  for (int n = 0; n < 32; n++) {
+    if ((inten & (1UL << n)) && reg(HOST_EVENTS + 4 * n)) {
+      hostPend(block);
+      return;
+    }
+  }
+}
+
+bool HostPeripheral::runnable()
+{
+  if (!busy()) {
+    return false;
+  }
+
+  return !inten || block >= HOST_IRQS || hostServiceable(block);
+}
+
+static bool decode(const volatile HostReg *reg, int &block, uint32_t &offset)
+{
+  uintptr_t index = (uintptr_t)(reg - &hostBlocks[0][0]);
+
+  if (index >= HOST_BLOCKS * 1024) {
+    return false;
+  }
+
+  block = index / 1024;
+  offset = (index % 1024) * 4;
+
+  return true;
+}
+
+static uint32_t regAccesses;
+
+// Unset events read since the last register write or peripheral step
+static const volatile HostReg *pollSeen[8];
+static int pollCount;
+
+static void pollReset()
+{
+  pollCount = 0;
+}
+
+static bool polled(const volatile HostReg *reg)
+{
+  for (int i = 0; i < pollCount; i++) {
+    if (pollSeen[i] == reg) {
+      return true;
+    }
+  }
+
+  if (pollCount == 8) {
+    return true;
+  }
+
+  pollSeen[pollCount++] = reg;
+
+  return false;
+}
+
+uint32_t hostRegRead(const volatile HostReg *reg)
+{
+  int block;
+  uint32_t offset;
+
+  if (!decode(reg, block, offset)) {
+    hostFault("register read outside the peripherals");
+  }
+
+  regAccesses++;
+
+  HostPeripheral *p = hostModels[block];
+
+  if (!p) {
+    return hostBlocks[block][offset / 4].value;
+  }
+
+  // Polling for an event: the hardware gets on with it, even when its
+  // interrupt is masked. Only a second look counts, so an ISR checking
+  // each of its events once does not see the bus run ahead of it.
+  if (offset >= HOST_EVENTS && offset < HOST_EVENTS_END && !p->reg(offset) && p->busy()) {
+    if (polled(reg)) {
+      hostStep(p);
+    }
+  }
+
+  uint32_t value = p->read(offset);
+
+  hostSettle();
+
+  return value;
+}
+
+void hostRegWrite(volatile HostReg *reg, uint32_t value)
+{
+  int block;
+  uint32_t offset;
+
+  if (!decode(reg, block, offset)) {
+    hostFault("register write outside the peripherals");
+  }
+
+  regAccesses++;
+
+  HostPeripheral *p = hostModels[block];
+
+  if (!p) {
+    hostBlocks[block][offset / 4].value = value;
+    return;
+  }
+
+  pollReset();
+  p->write(offset, value);
+
+  hostSettle();
+}
+
+void hostTrigger(uint32_t address)
+{
+  int block;
+  uint32_t offset;
+
+  if (!address) {
+    return;
+  }
+
+  if (!decode((const volatile HostReg *)(uintptr_t)address, block, offset) || offset >= HOST_EVENTS) {
+    hostFault("PPI task 0x%08x is not a task register", (unsigned)address);
+  }
+
+  if (hostModels[block]) {
+    hostModels[block]->task(offset);
+  }
+}
+
+void hostPend(int irq)
+{
+  irqPending[irq] = true;
+}
+
+bool hostServiceable(int irq)
+{
+  return !primask && irqEnabled[irq] && irqPriority[irq] < execPriority;
+}
+
+static int nextIrq()
+{
+  int best = -1;
+
+  for (int irq = 0; irq < HOST_IRQS; irq++) {
+    if (irqPending[irq] && hostServiceable(irq) && (best < 0 || irqPriority[irq] < irqPriority[best])) {
+      best = irq;
+    }
+  }
+
+  return best;
+}
+
+static void dispatch()
+{
+  int irq;
+
+  while ((irq = nextIrq()) >= 0) {
+    if (!vectors[irq]) {
+      hostFault("interrupt %d has no handler", irq);
+    }
+
+    if (++storm > STORM_LIMIT) {
+      hostFault("interrupt %d keeps coming back", irq);
+    }
+
+    irqPending[irq] = false;
+    irqCount[irq]++;
+
+    int priority = execPriority;
+    uint32_t exception = ipsr;
+
+    execPriority = irqPriority[irq];
+    ipsr = 16 + irq;
+
+    vectors[irq]();
+
+    execPriority = priority;
+    ipsr = exception;
+
+    // exception entry and return set the event register
+    wakeEvent = true;
+
+    // the line is a level: still asserted, it comes straight back
+    if (hostModels[irq]) {
+      hostModels[irq]->update();
+    }
+  }
+}
+
+void hostSettle(void)
+{
+  for (;;) {
+    dispatch();
+
+    HostPeripheral *next = NULL;
+
+    for (int block = 0; block < HOST_BLOCKS && !next; block++) {
+      if (hostModels[block] && hostModels[block]->runnable()) {
+        next = hostModels[block];
+      }
+    }
+
+    if (!next) {
+      return;
+    }
+
+    hostStep(next);
+  }
+}
+
+static uint64_t nextEvent()
+{
+  uint64_t next = UINT64_MAX;
+
+  for (int block = 0; block < HOST_BLOCKS; block++) {
+    if (hostModels[block]) {
+      uint64_t t = hostModels[block]->nextEvent();
+
+      if (t < next) {
+        next = t;
+      }
+    }
+  }
+
+  return next;
+}
+
+static void elapseTo(uint64_t target)
+{
+  for (;;) {
+    uint64_t next = nextEvent();
+
+    if (next > target) {
+      break;
+    }
+
+    if (next > hostNow) {
+      hostNow = next;
+    }
+
+    for (int block = 0; block < HOST_BLOCKS; block++) {
+      if (hostModels[block]) {
+        hostModels[block]->advance();
+      }
+    }
+  }
+
+  if (target > hostNow) {
+    hostNow = target;
+    storm = 0;
+  }
+}
+
+void hostElapse(uint64_t ns)
+{
+  elapseTo(hostNow + ns);
+}
+
+void hostStep(HostPeripheral *p)
+{
+  // every piece of work takes some time, so waiting always gets somewhere
+  uint64_t ns = p->step();
+
+  pollReset();
+  hostElapse(ns ? ns : 1);
+}
+
+static HostPeripheral *busyModel()
+{
+  for (int block = 0; block < HOST_BLOCKS; block++) {
+    if (hostModels[block] && hostModels[block]->busy()) {
+      return hostModels[block];
+    }
+  }
+
+  return NULL;
+}
+
+void hostIdle(uint64_t ns)
+{
+  uint64_t target = hostNow + ns;
+
+  for (;;) {
+    hostSettle();
+
+    if (hostNow >= target) {
+      return;
+    }
+
+    HostPeripheral *p = busyModel();
+
+    if (p) {
+      hostStep(p);
+    } else {
+      uint64_t next = nextEvent();
+
+      elapseTo(next < target ? next : target);
+    }
+  }
+}
+
+uint64_t hostTime(void)
+{
+  return hostNow;
+}
+
+uint32_t hostIrqCount(int irq)
+{
+  return irqCount[irq];
+}
+
+uint32_t hostRegAccesses(void)
+{
+  return regAccesses;
+}
+
+extern "C" {
+
+void __enable_irq(void)
+{
+  primask = 0;
+  hostSettle();
+}
+
+void __disable_irq(void)
+{
+  primask = 1;
+}
+
+uint32_t __get_PRIMASK(void)
+{
+  return primask;
+}
+
+void __set_PRIMASK(uint32_t priMask)
+{
+  primask = priMask & 1;
+
+  if (!primask) {
+    hostSettle();
+  }
+}
+
+uint32_t __get_IPSR(void)
+{
+  return ipsr;
+}
+
+// Sleeps until an interrupt or SEV, or returns early, which the
+// architecture allows. Sleeping with nothing left to wake the core is a
+// fault, as the firmware would hang.
+void __WFE(void)
+{
+  hostSettle();
+
+  if (!wakeEvent) {
+    HostPeripheral *p = busyModel();
+
+    if (p) {
+      hostStep(p);
+    } else {
+      uint64_t next = nextEvent();
+
+      if (next == UINT64_MAX) {
+        hostFault("__WFE() with nothing left to wake the core");
+      }
+
+      elapseTo(next);
+    }
+
+    hostSettle();
+  }
+
+  wakeEvent = false;
+}
+
+void __WFI(void)
+{
+  __WFE();
+}
+
+void __SEV(void)
+{
+  wakeEvent = true;
+}
+
+void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+  if (IRQn >= 0 && IRQn < HOST_IRQS) {
+    irqEnabled[IRQn] = true;
+    hostSettle();
+  }
+}
+
+void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+  if (IRQn >= 0 && IRQn < HOST_IRQS) {
+    irqEnabled[IRQn] = false;
+  }
+}
+
+uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn)
+{
+  return (IRQn >= 0 && IRQn < HOST_IRQS) ? irqPending[IRQn] : 0;
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type IRQn)
+{
+  if (IRQn >= 0 && IRQn < HOST_IRQS) {
+    irqPending[IRQn] = true;
+    hostSettle();
+  }
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn)
+{
+  if (IRQn >= 0 && IRQn < HOST_IRQS) {
+    irqPending[IRQn] = false;
+
+    if (hostModels[IRQn]) {
+      hostModels[IRQn]->update();
+    }
+  }
+}
+
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+  if (IRQn >= 0 && IRQn < HOST_IRQS) {
+    irqPriority[IRQn] = priority & ((1 << __NVIC_PRIO_BITS) - 1);
+    hostSettle();
+  }
+}
+
+uint32_t NVIC_GetPriority(IRQn_Type IRQn)
+{
+  return (IRQn >= 0 && IRQn < HOST_IRQS) ? irqPriority[IRQn] : 0;
+}
+
+void NVIC_SystemReset(void)
+{
+  hostFault("NVIC_SystemReset()");
+}
+
+// Reading the clock takes a microsecond, so that polling it gets somewhere
+uint32_t millis(void)
+{
+  hostIdle(1000);
+
+  return (uint32_t)(hostNow / 1000000);
+}
+
+uint32_t micros(void)
+{
+  hostIdle(1000);
+
+  return (uint32_t)(hostNow / 1000);
+}
+
+void delay(uint32_t ms)
+{
+  hostIdle((uint64_t)ms * 1000000);
+}
+
+}
+
+// The drivers keep RAM addresses in 32 bit registers, so the firmware's
+// stack and data must lie below 4 GB (see the link options in
+// CMakeLists.txt), and the stack above 0x20000000, where EasyDMA can reach
+static uint8_t firmwareStack[1 << 20] __attribute__((aligned(16)));
+
+struct HostTask
+{
+  int (*fn)(void);
+  int result;
+};
+
+static void *firmwareThread(void *arg)
+{
+  HostTask *t = static_cast<HostTask *>(arg);
+  uintptr_t sp = (uintptr_t)&t;
+
+  if (sp >> 32 || sp < 0x20000000) {
+    hostFault("firmware stack at %p is not in simulated RAM", (void *)sp);
+  }
+
+  t->result = t->fn();
+
+  return NULL;
+}
+
+int hostRun(int (*fn)(void))
+{
+  pthread_attr_t attr;
+  pthread_t thread;
+  HostTask t = { fn, 0 };
+
+  pthread_attr_init(&attr);
+  pthread_attr_setstack(&attr, firmwareStack, sizeof(firmwareStack));
+
+  if (pthread_create(&thread, &attr, firmwareThread, &t)) {
+    hostFault("cannot start the firmware thread");
+  }
+
+  pthread_join(thread, NULL);
+  pthread_attr_destroy(&attr);
+
+  return t.result;
+}
@@ -0,0 +1,138 @@
+/*
+  Simulated nRF52 peripherals for the host tests of Uart, SPI and Wire.
+
+  nrf.h includes the device header with every register typed as HostReg,
+  so a register access of the core calls into the peripheral models of
+  sim.cpp and peripherals.cpp. The models raise events, run PPI and pend
+  interrupts; the handlers run synchronously whenever the firmware side
+  could be interrupted (the NVIC priorities and PRIMASK are honoured).
+
+  Transfers take simulated bus time, kept apart from the host's clock:
+  millis(), micros(), delay() and the RTC and TIMER counters all read the
+  simulated clock.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Some drivers include the device header inside extern "C"
+extern "C++" {
+
+struct HostReg;
+
+uint32_t hostRegRead(const volatile HostReg *reg);
+void hostRegWrite(volatile HostReg *reg, uint32_t value);
+
+// A peripheral register. It has the size and alignment of the uint32_t it
+// stands for, so the device header's register layout is kept.
+struct HostReg
+{
+  uint32_t value;
+
+  operator uint32_t() const volatile { return hostRegRead(this); }
+
+  void operator=(uint32_t v) volatile { hostRegWrite(this, v); }
+  void operator|=(uint32_t v) volatile { hostRegWrite(this, hostRegRead(this) | v); }
+  void operator&=(uint32_t v) volatile { hostRegWrite(this, hostRegRead(this) & v); }
+  void operator^=(uint32_t v) volatile { hostRegWrite(this, hostRegRead(this) ^ v); }
+  void operator+=(uint32_t v) volatile { hostRegWrite(this, hostRegRead(this) + v); }
+  void operator-=(uint32_t v) volatile { hostRegWrite(this, hostRegRead(this) - v); }
+};
+
+// One 4 kB register block per peripheral: the APB peripherals by their ID
+// (which is also their IRQ number), then P0, FICR and UICR
+#define HOST_BLOCKS      67
+#define HOST_BLOCK_P0    64
+#define HOST_BLOCK_FICR  65
+#define HOST_BLOCK_UICR  66
+
+#define HOST_BLOCK(base) \
+  (((base) >> 28) == 0x5 ? HOST_BLOCK_P0 : \
+   ((base) >> 28) == 0x1 ? HOST_BLOCK_FICR + (((base) >> 12) & 1) : \
+   (int)(((base) >> 12) & 0x3F))
+
+#define HOST_BASE(base) ((uintptr_t)hostBlocks[HOST_BLOCK(base)])
+
+extern HostReg hostBlocks[HOST_BLOCKS][1024];
+
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Runs fn as the firmware's thread mode, on a stack in simulated RAM (the
+// drivers keep buffer addresses in 32 bit DMA pointers). Returns fn's
+// result.
+int hostRun(int (*fn)(void));
+
+// Simulated time in nanoseconds, and letting it pass with the peripherals
+// running and the interrupts that fall due handled
+uint64_t hostTime(void);
+void hostIdle(uint64_t ns);
+
+// Interrupts taken so far, by IRQ number
+uint32_t hostIrqCount(int irq);
+
+// Peripheral register reads and writes by the firmware so far, a measure
+// of the CPU time a driver spends on the hardware
+uint32_t hostRegAccesses(void);
+
+// External level of an input pin (high by default, as with a pull-up)
+// and the level the pin is driven to
+void hostPinLevel(uint32_t pin, int level);
+int hostPinRead(uint32_t pin);
+
+// The UARTE line: bytes arriving on RXD, one frame time apart, and the
+// bytes sent on TXD so far (taken out of the capture). With loopback on,
+// TXD is also fed back to RXD.
+void hostUartReceive(const uint8_t *data, size_t size);
+size_t hostUartSent(uint8_t *data, size_t size);
+void hostUartLoopback(int on);
+
+// The SPI device on the bus of SPI(M) instance 0-2: called for every
+// byte with MOSI, returns MISO. Without one, MOSI loops back to MISO.
+typedef uint8_t (*HostSpiDevice)(uint8_t mosi, void *arg);
+void hostSpiDevice(int instance, HostSpiDevice device, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+extern "C++" {
+
+// An I2C slave on the bus of TWIM instance 0 or 1: a register file where
+// the first byte written selects the register, following writes fill it
+// from there and reads carry on from the selected one.
+struct HostI2cSlave
+{
+  uint8_t address;
+  uint8_t regs[256];
+  uint8_t pointer;
+  bool stretch;           // holds SCL low for good, for timeout tests
+  uint32_t transfers;     // address phases acknowledged
+};
+
+void hostI2cAttach(int instance, HostI2cSlave *slave);
+void hostI2cDetach(int instance);
+
+}
+
+#endif
@@ -0,0 +1,132 @@
+/*
+  Host unit test for String, Print and Stream.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdio.h>
+#include <string>
+
+#include "Stream.h"
+
+static int failures;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      failures++; \
+    } \
+  } while (0)
+
+// Reads from a fixed input and collects what is printed
+class BufferStream : public Stream
+{
+  public:
+    BufferStream(const char *input = "") : in(input), pos(0) {}
+
+    size_t write(uint8_t c) { out += (char)c; return 1; }
+    using Print::write;
+
+    int available() { return (int)(in.size() - pos); }
+    int read() { return (pos < in.size()) ? (uint8_t)in[pos++] : -1; }
+    int peek() { return (pos < in.size()) ? (uint8_t)in[pos] : -1; }
+    void flush() {}
+
+    std::string in;
+    size_t pos;
+    std::string out;
+};
+
+static void testPrint()
+{
+  BufferStream s;
+
+  s.print(42);
+  s.print(' ');
+  s.print(-42);
+  s.print(' ');
+  s.print(255, HEX);
+  s.print(' ');
+  s.print(5, BIN);
+  s.print(' ');
+  s.print(3.14159, 2);
+  s.println(" end");
+
+  CHECK(s.out == "42 -42 FF 101 3.14 end\r\n");
+}
+
+static void testString()
+{
+  String a(1234);
+  String b(0xAB, HEX);
+  String c(1.5f);
+  String d = String("x=") + 7 + ',' + a;
+
+  CHECK(a.length() == 4);
+  CHECK(b == "ab");
+  CHECK(c == "1.50");
+  CHECK(d == "x=7,1234");
+  CHECK(d.indexOf(',') == 3);
+  CHECK(d.substring(4).toInt() == 1234);
+
+  d.replace("1234", "5");
+  CHECK(d == "x=7,5");
+}
+
+static void testParse()
+{
+  BufferStream s("12 abc,-7\n");
+
+  s.setTimeout(0);
+
+  CHECK(s.parseInt() == 12);
+  CHECK(s.readStringUntil(',') == " abc");
+  CHECK(s.parseInt() == -7);
+  CHECK(s.read() == '\n');
+  CHECK(s.read() == -1);
+}
+
+static void testTimeout()
+{
+  BufferStream s;
+  char buf[4];
+
+  s.setTimeout(20);
+
+  unsigned long start = millis();
+  size_t n = s.readBytes(buf, sizeof(buf));
+  unsigned long elapsed = millis() - start;
+
+  CHECK(n == 0);
+  CHECK(elapsed >= 20);
+}
+
+int main()
+{
+  testPrint();
+  testString();
+  testParse();
+  testTimeout();
+
+  if (failures) {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  printf("all checks passed\n");
+
+  return 0;
+}
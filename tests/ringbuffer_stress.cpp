@@ -0,0 +1,193 @@
+/*
+  Two-thread stress test for RingBufferN, run on the host:
+
+    g++ -std=gnu++11 -O2 -pthread -Icores/nRF5 tests/ringbuffer_stress.cpp -o ringbuffer_stress
+    ./ringbuffer_stress [bytes]
+
+  A producer thread stores a running byte sequence while a consumer thread
+  reads it back, each through all of its single-byte, bulk and zero-copy
+  calls with varying sizes. Any lost, repeated or torn byte breaks the
+  sequence. The byte count defaults to STRESS_BYTES, which is kept short
+  for CI; pass a larger one (e.g. 4000000000) for a long run, or build
+  with HOST_LONG_TESTS and run ctest -L long. RingBufferN relies on
+  acquire/release ordering only, so this is best run on a weakly ordered
+  host (e.g. ARM) as well as on x86.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+#include "RingBuffer.h"
+
+#ifndef STRESS_BYTES
+#define STRESS_BYTES 4000000ULL
+#endif
+
+static uint64_t total = STRESS_BYTES;
+static RingBufferN<64> ring;
+static volatile bool failed;
+
+// xorshift, so both threads pick sizes without sharing state
+static uint32_t next(uint32_t &state)
+{
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+
+  return state;
+}
+
+static void producer()
+{
+  uint32_t rng = 0x12345678;
+  uint64_t seq = 0;
+  uint8_t chunk[80];
+
+  while (seq < total && !failed) {
+    uint32_t r = next(rng);
+
+    // let the consumer in on a single core host
+    if (ring.isFull()) {
+      std::this_thread::yield();
+    }
+
+    if ((r & 3) == 1) {
+      if (!ring.isFull()) {
+        ring.store_char((uint8_t)seq++);
+      }
+    } else if ((r & 3) == 3) {
+      // as EasyDMA writes it
+      size_t n = ring.contiguousForStore();
+      uint8_t *p = ring.headPtr();
+
+      if (n > total - seq) {
+        n = total - seq;
+      }
+      for (size_t i = 0; i < n; i++) {
+        p[i] = (uint8_t)(seq + i);
+      }
+
+      ring.advanceHead(n);
+      seq += n;
+    } else {
+      // sizes past the buffer size check that write() clips
+      size_t n = (r >> 8) % sizeof(chunk) + 1;
+
+      if (n > total - seq) {
+        n = total - seq;
+      }
+      for (size_t i = 0; i < n; i++) {
+        chunk[i] = (uint8_t)(seq + i);
+      }
+
+      seq += ring.write(chunk, n);
+    }
+  }
+}
+
+static bool check(uint64_t &seq, int c)
+{
+  if (c != (uint8_t)seq) {
+    fprintf(stderr, "byte %" PRIu64 ": got %d, expected %d\n", seq, c, (uint8_t)seq);
+    failed = true;
+    return false;
+  }
+
+  seq++;
+
+  return true;
+}
+
+static void consumer()
+{
+  uint32_t rng = 0x9abcdef0;
+  uint64_t seq = 0;
+  uint8_t chunk[80];
+
+  while (seq < total && !failed) {
+    uint32_t r = next(rng);
+
+    if (!ring.available()) {
+      std::this_thread::yield();
+    }
+
+    switch (r & 3) {
+      case 0: {
+        int peeked = ring.peek();
+        int c = ring.read_char();
+
+        if (c < 0) {
+          break;
+        }
+        // the producer may have stored something after an empty peek
+        if (peeked >= 0 && peeked != c) {
+          fprintf(stderr, "byte %" PRIu64 ": peek %d, read %d\n", seq, peeked, c);
+          failed = true;
+          return;
+        }
+        check(seq, c);
+        break;
+      }
+
+      case 1:
+      case 2: {
+        size_t n = ring.read(chunk, (r >> 8) % sizeof(chunk) + 1);
+
+        for (size_t i = 0; i < n && check(seq, chunk[i]); i++);
+        break;
+      }
+
+      case 3: {
+        // as EasyDMA reads it
+        size_t n = ring.contiguousAvailable();
+        const uint8_t *p = ring.tailPtr();
+
+        for (size_t i = 0; i < n && check(seq, p[i]); i++);
+        ring.advanceTail(n);
+        break;
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1) {
+    total = strtoull(argv[1], NULL, 0);
+  }
+
+  std::thread p(producer);
+  std::thread c(consumer);
+
+  p.join();
+  c.join();
+
+  if (failed) {
+    return EXIT_FAILURE;
+  }
+
+  if (ring.available() != 0) {
+    fprintf(stderr, "%d bytes left over\n", ring.available());
+    return EXIT_FAILURE;
+  }
+
+  printf("%" PRIu64 " bytes passed through in order\n", total);
+
+  return EXIT_SUCCESS;
+}
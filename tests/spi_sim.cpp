@@ -0,0 +1,252 @@
+/*
+  Host unit test for SPIClass on the simulated SPIM.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdio.h>
+
+#include "Arduino.h"
+#include "SPI.h"
+#include "sim.h"
+
+static int failures;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      failures++; \
+    } \
+  } while (0)
+
+// A device that answers each byte with its complement, and notes what it
+// got and whether it was selected at the time
+struct Device {
+  uint8_t mosi[1024];
+  size_t count;
+  size_t unselected;
+  int csPin;
+};
+
+static Device device;
+
+static uint8_t exchange(uint8_t mosi, void *arg)
+{
+  Device *d = (Device *)arg;
+
+  if (d->count < sizeof(d->mosi)) {
+    d->mosi[d->count] = mosi;
+  }
+  d->count++;
+
+  if (d->csPin >= 0 && hostPinRead(d->csPin)) {
+    d->unselected++;
+  }
+
+  return (uint8_t)~mosi;
+}
+
+static void reset(int csPin = -1)
+{
+  memset(&device, 0, sizeof(device));
+  device.csPin = csPin;
+}
+
+// in flash, so SPIM has to send it from a RAM copy
+static const uint8_t pattern[300] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+static void testTransfer()
+{
+  reset();
+
+  SPI.beginTransaction(SPISettings(8000000, MSBFIRST, SPI_MODE0));
+
+  CHECK(SPI.transfer(0x5A) == 0xA5);
+  CHECK(SPI.transfer16(0x1234) == 0xEDCB);
+
+  CHECK(device.count == 3);
+  CHECK(device.mosi[0] == 0x5A);
+  CHECK(device.mosi[1] == 0x12);
+  CHECK(device.mosi[2] == 0x34);
+
+  SPI.endTransaction();
+}
+
+// longer than one DMA chunk, in place
+static void testTransferBlock()
+{
+  uint8_t buf[600];
+
+  reset();
+
+  for (size_t i = 0; i < sizeof(buf); i++) {
+    buf[i] = (uint8_t)i;
+  }
+
+  SPI.beginTransaction(SPISettings());
+  SPI.transfer(buf, sizeof(buf));
+  SPI.endTransaction();
+
+  CHECK(device.count == sizeof(buf));
+
+  for (size_t i = 0; i < sizeof(buf); i++) {
+    CHECK(device.mosi[i] == (uint8_t)i);
+    CHECK(buf[i] == (uint8_t)~i);
+  }
+}
+
+static void testTransferFlash()
+{
+  uint8_t rx[sizeof(pattern)];
+
+  reset();
+
+  SPI.beginTransaction(SPISettings());
+  SPI.transfer(pattern, rx, sizeof(pattern));
+  SPI.transfer(NULL, rx, 4);
+  SPI.endTransaction();
+
+  CHECK(device.count == sizeof(pattern) + 4);
+  CHECK(memcmp(device.mosi, pattern, sizeof(pattern)) == 0);
+  CHECK(device.mosi[sizeof(pattern)] == 0xFF);
+  CHECK(rx[0] == 0x00);
+}
+
+static int order[8];
+static volatile int done;
+
+static void finished(void *arg)
+{
+  order[done++] = (int)(intptr_t)arg;
+}
+
+// Queued transfers finish in order, empty ones included, and a
+// synchronous transfer waits for them
+static void testAsync()
+{
+  static uint8_t a[100], b[10];
+  static uint8_t ra[100];
+
+  reset();
+  done = 0;
+
+  memset(a, 0x11, sizeof(a));
+  memset(b, 0x22, sizeof(b));
+
+  SPISettings settings(4000000, MSBFIRST, SPI_MODE0);
+
+  CHECK(SPI.transferAsync(settings, -1, a, ra, sizeof(a), finished, (void *)1));
+  CHECK(SPI.transferAsync(settings, -1, NULL, NULL, 0, finished, (void *)2));
+  CHECK(SPI.transferAsync(settings, -1, b, NULL, sizeof(b), finished, (void *)3));
+
+  SPI.beginTransaction(settings);
+  CHECK(SPI.transfer(0x33) == 0xCC);
+  SPI.endTransaction();
+
+  CHECK(done == 3);
+  CHECK(order[0] == 1 && order[1] == 2 && order[2] == 3);
+
+  CHECK(device.count == sizeof(a) + sizeof(b) + 1);
+  CHECK(device.mosi[0] == 0x11);
+  CHECK(device.mosi[sizeof(a)] == 0x22);
+  CHECK(device.mosi[sizeof(a) + sizeof(b)] == 0x33);
+  CHECK(ra[0] == 0xEE);
+}
+
+// GPIOTE holds CS low for exactly the transfer
+static void testHardwareCS()
+{
+  uint8_t buf[32];
+  uint32_t cs = g_ADigitalPinMap[SS];
+
+  reset(cs);
+  memset(buf, 0, sizeof(buf));
+
+  CHECK(SPI.setHardwareCS(SS));
+  CHECK(hostPinRead(cs) == 1);
+
+  SPI.beginTransaction(SPISettings());
+  SPI.transfer(buf, sizeof(buf));
+  SPI.endTransaction();
+
+  CHECK(device.count == sizeof(buf));
+  CHECK(device.unselected == 0);
+  CHECK(hostPinRead(cs) == 1);
+
+  SPI.setHardwareCS(-1);
+}
+
+// an array list stream sends a block of many chunks with one callback
+static void testStream()
+{
+  static uint8_t frame[SPI_DMA_MAXCNT * 4];
+
+  reset();
+  done = 0;
+
+  for (size_t i = 0; i < sizeof(frame); i++) {
+    frame[i] = (uint8_t)(i / SPI_DMA_MAXCNT);
+  }
+
+  CHECK(SPI.setStreamTimer(NRF_TIMER3));
+
+  uint32_t irqs = hostIrqCount(SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn);
+
+  CHECK(SPI.streamAsync(frame, sizeof(frame), finished, (void *)4));
+
+  while (!done) {
+    delay(1);
+  }
+
+  irqs = hostIrqCount(SPIM0_SPIS0_TWIM0_TWIS0_SPI0_TWI0_IRQn) - irqs;
+
+  CHECK(order[0] == 4);
+  CHECK(device.count == sizeof(frame));
+  CHECK(memcmp(device.mosi, frame, sizeof(frame)) == 0);
+  CHECK(irqs < 4);
+
+  SPI.setStreamTimer(NULL);
+}
+
+static int run()
+{
+  hostSpiDevice(0, exchange, &device);
+
+  SPI.begin();
+
+  testTransfer();
+  testTransferBlock();
+  testTransferFlash();
+  testAsync();
+  testHardwareCS();
+  testStream();
+
+  SPI.end();
+
+  return failures;
+}
+
+int main()
+{
+  if (hostRun(run)) {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  printf("all checks passed\n");
+
+  return 0;
+}
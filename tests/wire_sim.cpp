@@ -0,0 +1,253 @@
+/*
+  Host unit test for TwoWire on the simulated TWIM.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdio.h>
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "sim.h"
+
+static int failures;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      failures++; \
+    } \
+  } while (0)
+
+#define ADDRESS 0x48
+
+static HostI2cSlave slave;
+
+static void reset()
+{
+  memset(&slave, 0, sizeof(slave));
+  slave.address = ADDRESS;
+
+  for (int i = 0; i < 256; i++) {
+    slave.regs[i] = (uint8_t)(i ^ 0x5A);
+  }
+}
+
+static void testWrite()
+{
+  reset();
+
+  Wire.beginTransmission(ADDRESS);
+  Wire.write(0x10);
+  Wire.write(0xAB);
+  Wire.write(0xCD);
+
+  CHECK(Wire.endTransmission() == 0);
+  CHECK(slave.regs[0x10] == 0xAB);
+  CHECK(slave.regs[0x11] == 0xCD);
+  CHECK(slave.transfers == 1);
+}
+
+static void testRead()
+{
+  reset();
+
+  Wire.beginTransmission(ADDRESS);
+  Wire.write(0x20);
+  CHECK(Wire.endTransmission(false) == 0);
+
+  CHECK(Wire.requestFrom(ADDRESS, 4) == 4);
+  CHECK(Wire.available() == 4);
+
+  for (int i = 0; i < 4; i++) {
+    CHECK(Wire.read() == ((0x20 + i) ^ 0x5A));
+  }
+
+  CHECK(Wire.available() == 0);
+}
+
+// register number and data in one hardware sequence
+static void testWriteThenRead()
+{
+  uint8_t reg = 0x30;
+  uint8_t data[6];
+
+  reset();
+
+  CHECK(Wire.writeThenRead(ADDRESS, &reg, 1, data, sizeof(data)) == 0);
+
+  for (size_t i = 0; i < sizeof(data); i++) {
+    CHECK(data[i] == ((0x30 + i) ^ 0x5A));
+  }
+
+  CHECK(slave.transfers == 2);
+}
+
+// reads longer than one DMA transfer are chained
+static void testReadLong()
+{
+  uint8_t data[256 + 100];
+
+  reset();
+  slave.pointer = 0;
+
+  CHECK(Wire.readBuffer(ADDRESS, data, sizeof(data)) == sizeof(data));
+
+  for (size_t i = 0; i < sizeof(data); i++) {
+    CHECK(data[i] == ((uint8_t)i ^ 0x5A));
+  }
+}
+
+// the write is sent from a RAM copy
+static const uint8_t config[] = { 0x40, 1, 2, 3 };
+
+static void testWriteFlash()
+{
+  reset();
+
+  CHECK(Wire.writeBuffer(ADDRESS, config, sizeof(config)) == 0);
+  CHECK(slave.regs[0x40] == 1 && slave.regs[0x42] == 3);
+}
+
+static void testNack()
+{
+  reset();
+
+  Wire.beginTransmission(ADDRESS + 1);
+  Wire.write((uint8_t)0);
+
+  CHECK(Wire.endTransmission() == 2);
+  CHECK(Wire.requestFrom(ADDRESS + 1, 2) == 0);
+
+  // the bus is free again afterwards
+  Wire.beginTransmission(ADDRESS);
+  Wire.write((uint8_t)0);
+  CHECK(Wire.endTransmission() == 0);
+}
+
+// a slave holding SCL low is given up on after the timeout
+static void testTimeout()
+{
+  reset();
+  slave.stretch = true;
+
+  Wire.setWireTimeout(2000, true);
+  Wire.clearWireTimeoutFlag();
+
+  uint64_t start = hostTime();
+
+  Wire.beginTransmission(ADDRESS);
+  Wire.write((uint8_t)0);
+
+  CHECK(Wire.endTransmission() == 5);
+  CHECK(Wire.getWireTimeoutFlag());
+  CHECK(hostTime() - start < 10000000);
+
+  slave.stretch = false;
+  Wire.clearWireTimeoutFlag();
+  Wire.setWireTimeout(0);
+
+  Wire.beginTransmission(ADDRESS);
+  Wire.write((uint8_t)0);
+  CHECK(Wire.endTransmission() == 0);
+}
+
+static volatile int asyncStatus;
+
+static void asyncDone(uint8_t status, void *arg)
+{
+  (void)arg;
+  asyncStatus = status;
+}
+
+static void testAsync()
+{
+  static uint8_t reg = 0x50;
+  static uint8_t data[3];
+
+  reset();
+  asyncStatus = -1;
+
+  CHECK(Wire.writeThenReadAsync(ADDRESS, &reg, 1, data, sizeof(data), true, asyncDone));
+
+  while (asyncStatus < 0) {
+    delay(1);
+  }
+
+  CHECK(asyncStatus == 0);
+  CHECK(data[2] == (0x52 ^ 0x5A));
+}
+
+// the scheduler reads a register every period, off the RTC
+static void testSchedule()
+{
+  static uint8_t buffer[4];
+  uint8_t value[2];
+  WireJob job(ADDRESS, 0x60, 2, 10, buffer);
+
+  reset();
+
+  CHECK(Wire.schedule(job));
+
+  delay(105);
+
+  Wire.unschedule(job);
+
+  CHECK(job.reads() >= 9 && job.reads() <= 11);
+  CHECK(job.errors() == 0);
+  CHECK(job.read(value));
+  CHECK(value[0] == (0x60 ^ 0x5A) && value[1] == (0x61 ^ 0x5A));
+
+  // a blocking transfer still gets the bus
+  Wire.beginTransmission(ADDRESS);
+  Wire.write((uint8_t)0);
+  CHECK(Wire.endTransmission() == 0);
+}
+
+static int run()
+{
+  hostI2cAttach(1, &slave);
+
+  Wire.begin();
+  Wire.setClock(400000);
+
+  testWrite();
+  testRead();
+  testWriteThenRead();
+  testReadLong();
+  testWriteFlash();
+  testNack();
+  testTimeout();
+  testAsync();
+  testSchedule();
+
+  Wire.end();
+  hostI2cDetach(1);
+
+  return failures;
+}
+
+int main()
+{
+  if (hostRun(run)) {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  printf("all checks passed\n");
+
+  return 0;
+}
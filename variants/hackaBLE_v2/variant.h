@@ -79,7 +79,10 @@ static const uint8_t AREF = PIN_AREF;
 /*
  * SPI Interfaces
  */
+// Up to 3 on nRF52; the extra ports get their pins from setPins()
+#ifndef SPI_INTERFACES_COUNT
 #define SPI_INTERFACES_COUNT 1
+#endif
 
 #define PIN_SPI_MISO         (11)
 #define PIN_SPI_MOSI         (12)
@@ -94,7 +97,10 @@ static const uint8_t SCK  = PIN_SPI_SCK ;
 /*
  * Wire Interfaces
  */
+// Up to 2 on nRF52; Wire1 gets its pins from setPins()
+#ifndef WIRE_INTERFACES_COUNT
 #define WIRE_INTERFACES_COUNT 1
+#endif
 
 #define PIN_WIRE_SDA         (2)
 #define PIN_WIRE_SCL         (3)